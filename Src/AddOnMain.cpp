@@ -1,5 +1,8 @@
 #include "APIEnvir.h"
+#include "FailingDefinitionCache.hpp"
 #include "JsonExportDialog.hpp"
+#include "PropertyCache.hpp"
+#include "QueryServer.hpp"
 
 static const GSResID AddOnInfoID = ID_ADDON_INFO;
 static const Int32 AddOnNameID = 1;
@@ -22,6 +25,15 @@ static GSErrCode MenuCommandHandler(const API_MenuParams* menuParams)
   return NoError;
 }
 
+static GSErrCode __ACENV_CALL ProjectEventHandler(API_NotifyEventID, Int32)
+{
+  // Cached values are keyed by element guid and modification stamp, which can repeat in another project, such as a
+  // copy of the one that was open
+  PropertyCache::GetSessionCache().Clear();
+  FailingDefinitionCache::GetSessionCache().Clear();
+  return NoError;
+}
+
 API_AddonType CheckEnvironment(API_EnvirParams* envir)
 {
   RSGetIndString(&envir->addOnInfo.name, AddOnInfoID, AddOnNameID, ACAPI_GetOwnResModule());
@@ -41,14 +53,22 @@ GSErrCode RegisterInterface(void)
 
 GSErrCode Initialize(void)
 {
+  // Session caches are emptied whenever the open project changes
+  const GSFlags projectEvents = APINotify_New | APINotify_NewAndReset | APINotify_Open | APINotify_Close | APINotify_Quit;
 #ifdef ServerMainVers_2700
-  return ACAPI_MenuItem_InstallMenuHandler(AddOnMenuID, MenuCommandHandler);
+  GSErrCode err = ACAPI_ProjectOperation_CatchProjectEvent(projectEvents, ProjectEventHandler);
+  if (err == NoError)
+    err = ACAPI_MenuItem_InstallMenuHandler(AddOnMenuID, MenuCommandHandler);
 #else
-  return ACAPI_Install_MenuHandler(AddOnMenuID, MenuCommandHandler);
+  GSErrCode err = ACAPI_Notify_CatchProjectEvent(projectEvents, ProjectEventHandler);
+  if (err == NoError)
+    err = ACAPI_Install_MenuHandler(AddOnMenuID, MenuCommandHandler);
 #endif
+  return err;
 }
 
 GSErrCode FreeData(void)
 {
+  QueryServer::GetSessionServer().Stop();
   return NoError;
 }
\ No newline at end of file
@@ -0,0 +1,825 @@
+#include "ArrowSerializer.hpp"
+#include "GuidFormatter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Identifiers taken from the Arrow flatbuffer schemas (Schema.fbs, Message.fbs and File.fbs)
+const int16_t MetadataVersionV5 = 4;
+const uint8_t MessageHeaderSchema = 1;
+const uint8_t MessageHeaderDictionaryBatch = 2;
+const uint8_t MessageHeaderRecordBatch = 3;
+const uint8_t TypeInt = 2;
+const uint8_t TypeFloatingPoint = 3;
+const uint8_t TypeUtf8 = 5;
+const uint8_t TypeBool = 6;
+const uint8_t TypeList = 12;
+const uint8_t TypeLargeUtf8 = 20;
+const uint8_t TypeLargeList = 21;
+const int16_t PrecisionDouble = 2;
+
+const char ArrowMagic[] = "ARROW1";
+const size_t ArrowAlignment = 8;
+
+/**
+ * @brief Minimal flatbuffer builder covering the subset of features needed for Arrow metadata. As with the
+ * reference implementation, the buffer is built back to front so that child objects are created before their
+ * parents, and offsets are tracked as distances from the end of the buffer.
+ */
+class FlatBufferBuilder {
+public:
+  typedef uint32_t Offset;
+
+  FlatBufferBuilder() :
+    m_buffer(1024),
+    m_head(1024),
+    m_minAlign(1),
+    m_tableStart(0)
+  {
+  }
+
+  Offset CreateString(const std::string& str)
+  {
+    PreAlign(str.size() + 1, sizeof(uint32_t));
+    PushZeros(1);
+    PushBytes(str.data(), str.size());
+    PushScalar<uint32_t>(static_cast<uint32_t>(str.size()));
+    return GetSize();
+  }
+
+  Offset CreateOffsetVector(const std::vector<Offset>& offsets)
+  {
+    PreAlign(offsets.size() * sizeof(uint32_t), sizeof(uint32_t));
+    for (auto it = offsets.rbegin(); it != offsets.rend(); ++it)
+      PushOffset(*it);
+
+    PushScalar<uint32_t>(static_cast<uint32_t>(offsets.size()));
+    return GetSize();
+  }
+
+  template <typename T>
+  Offset CreateStructVector(const std::vector<T>& structs)
+  {
+    size_t length = structs.size() * sizeof(T);
+    PreAlign(length, sizeof(uint32_t));
+    PreAlign(length, alignof(T));
+    PushBytes(structs.data(), length);
+    PushScalar<uint32_t>(static_cast<uint32_t>(structs.size()));
+    return GetSize();
+  }
+
+  void StartTable()
+  {
+    m_fields.clear();
+    m_tableStart = GetSize();
+  }
+
+  template <typename T>
+  void AddField(uint16_t fieldId, T value)
+  {
+    PushScalar(value);
+    m_fields.push_back({ fieldId, GetSize() });
+  }
+
+  void AddOffsetField(uint16_t fieldId, Offset offset)
+  {
+    PushOffset(offset);
+    m_fields.push_back({ fieldId, GetSize() });
+  }
+
+  Offset EndTable()
+  {
+    // Reserve the vtable reference at the start of the table
+    PushScalar<int32_t>(0);
+    Offset tableOffset = GetSize();
+
+    uint16_t fieldCount = 0;
+    for (const FieldLocation& field : m_fields)
+      fieldCount = std::max<uint16_t>(fieldCount, field.id + 1);
+
+    std::vector<uint16_t> fieldOffsets(fieldCount, 0);
+    for (const FieldLocation& field : m_fields)
+      fieldOffsets[field.id] = static_cast<uint16_t>(tableOffset - field.location);
+
+    // Write the vtable, which precedes the table in the final buffer
+    for (auto it = fieldOffsets.rbegin(); it != fieldOffsets.rend(); ++it)
+      PushScalar<uint16_t>(*it);
+    PushScalar<uint16_t>(static_cast<uint16_t>(tableOffset - m_tableStart));
+    PushScalar<uint16_t>(static_cast<uint16_t>((fieldCount + 2) * sizeof(uint16_t)));
+
+    int32_t vtableDistance = static_cast<int32_t>(GetSize() - tableOffset);
+    std::memcpy(m_buffer.data() + m_buffer.size() - tableOffset, &vtableDistance, sizeof(int32_t));
+    return tableOffset;
+  }
+
+  std::string Finish(Offset root)
+  {
+    PreAlign(sizeof(uint32_t), m_minAlign);
+    PushOffset(root);
+    return std::string(reinterpret_cast<const char*>(m_buffer.data() + m_head), GetSize());
+  }
+
+private:
+  struct FieldLocation
+  {
+    uint16_t id;
+    size_t location;
+  };
+
+  size_t GetSize() const
+  {
+    return m_buffer.size() - m_head;
+  }
+
+  template <typename T>
+  void PushScalar(T value)
+  {
+    PreAlign(sizeof(T), sizeof(T));
+    PushBytes(&value, sizeof(T));
+  }
+
+  void PushOffset(Offset offset)
+  {
+    PreAlign(sizeof(uint32_t), sizeof(uint32_t));
+    uint32_t relativeOffset = static_cast<uint32_t>(GetSize() - offset + sizeof(uint32_t));
+    PushBytes(&relativeOffset, sizeof(uint32_t));
+  }
+
+  void PreAlign(size_t length, size_t alignment)
+  {
+    m_minAlign = std::max(m_minAlign, alignment);
+    PushZeros((~(GetSize() + length) + 1) & (alignment - 1));
+  }
+
+  void PushZeros(size_t length)
+  {
+    Reserve(length);
+    m_head -= length;
+    std::memset(m_buffer.data() + m_head, 0, length);
+  }
+
+  void PushBytes(const void* bytes, size_t length)
+  {
+    Reserve(length);
+    m_head -= length;
+    std::memcpy(m_buffer.data() + m_head, bytes, length);
+  }
+
+  void Reserve(size_t length)
+  {
+    if (m_head >= length)
+      return;
+
+    // Grow the buffer, keeping the existing content at the end
+    size_t usedSize = GetSize();
+    size_t newSize = std::max(m_buffer.size() * 2, usedSize + length);
+    std::vector<uint8_t> newBuffer(newSize);
+    std::memcpy(newBuffer.data() + newSize - usedSize, m_buffer.data() + m_head, usedSize);
+    m_buffer.swap(newBuffer);
+    m_head = newSize - usedSize;
+  }
+
+  std::vector<uint8_t> m_buffer;
+  size_t m_head;
+  size_t m_minAlign;
+  size_t m_tableStart;
+  std::vector<FieldLocation> m_fields;
+};
+
+struct FieldNode
+{
+  int64_t length;
+  int64_t nullCount;
+};
+
+struct BufferLocation
+{
+  int64_t offset;
+  int64_t length;
+};
+
+struct Block
+{
+  int64_t offset;
+  int32_t metaDataLength;
+  int32_t padding;
+  int64_t bodyLength;
+};
+
+template <typename T>
+void AppendValue(std::string& buffer, T value)
+{
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void AppendBit(std::string& bitmap, int64_t index, bool value)
+{
+  if (index % 8 == 0)
+    bitmap.push_back('\0');
+  if (value)
+    bitmap.back() |= static_cast<char>(1 << (index % 8));
+}
+
+/**
+ * @brief Accumulates the buffers of a single Arrow array. Offset-based arrays (strings and lists) keep their
+ * offsets in the values buffer and must be created with InitOffsets. Offsets are 32-bit until one no longer fits,
+ * when they are widened to 64-bit and the array becomes a large string or list array.
+ */
+struct ArrayBuilder
+{
+  int64_t length = 0;
+  int64_t nullCount = 0;
+  bool isLarge = false;
+  std::string validity;
+  std::string values;
+  std::string data;
+
+  void InitOffsets()
+  {
+    AppendValue<int32_t>(values, 0);
+  }
+
+  void AppendOffset(int64_t offset)
+  {
+    if (!isLarge && offset > std::numeric_limits<int32_t>::max())
+      WidenOffsets();
+
+    if (isLarge)
+      AppendValue<int64_t>(values, offset);
+    else
+      AppendValue<int32_t>(values, static_cast<int32_t>(offset));
+  }
+
+  void WidenOffsets()
+  {
+    std::string wideValues;
+    wideValues.reserve(values.size() * 2);
+    for (size_t i = 0; i < values.size(); i += sizeof(int32_t))
+    {
+      int32_t offset;
+      std::memcpy(&offset, values.data() + i, sizeof(int32_t));
+      AppendValue<int64_t>(wideValues, offset);
+    }
+    values.swap(wideValues);
+    isLarge = true;
+  }
+
+  void AppendValidity(bool isValid)
+  {
+    AppendBit(validity, length, isValid);
+    if (!isValid)
+      ++nullCount;
+    ++length;
+  }
+
+  void AppendInt(bool isValid, int32_t value)
+  {
+    AppendValue<int32_t>(values, isValid ? value : 0);
+    AppendValidity(isValid);
+  }
+
+  void AppendReal(bool isValid, double value)
+  {
+    AppendValue<double>(values, isValid ? value : 0.0);
+    AppendValidity(isValid);
+  }
+
+  void AppendBool(bool isValid, bool value)
+  {
+    AppendBit(values, length, isValid && value);
+    AppendValidity(isValid);
+  }
+
+  void AppendString(bool isValid, const std::string& value)
+  {
+    if (isValid)
+      data.append(value);
+    AppendOffset(static_cast<int64_t>(data.size()));
+    AppendValidity(isValid);
+  }
+};
+
+/**
+ * @brief Maps distinct strings of a dictionary-encoded column to their indices
+ */
+struct StringDictionary
+{
+  std::unordered_map<std::string, int32_t> indices;
+  ArrayBuilder values;
+
+  StringDictionary()
+  {
+    values.InitOffsets();
+  }
+
+  int32_t GetIndex(const std::string& str)
+  {
+    auto it = indices.find(str);
+    if (it != indices.end())
+      return it->second;
+
+    int32_t index = static_cast<int32_t>(values.length);
+    values.AppendString(true, str);
+    indices.emplace(str, index);
+    return index;
+  }
+};
+
+enum class ColumnType
+{
+  Int,
+  Real,
+  Bool,
+  String,
+  DictionaryString
+};
+
+/**
+ * @brief Holds the array data of an exported column. List properties are stored as Arrow lists, with their
+ * items held in a child array.
+ */
+struct Column
+{
+  std::string name;
+  ColumnType type;
+  bool isList;
+  bool isNullable;
+  int64_t dictionaryId;
+  ArrayBuilder array;
+  ArrayBuilder items;
+  StringDictionary dictionary;
+
+  Column(const std::string& columnName, ColumnType columnType, bool isListColumn, bool isNullableColumn, int64_t columnDictionaryId) :
+    name(columnName),
+    type(columnType),
+    isList(isListColumn),
+    isNullable(isNullableColumn),
+    dictionaryId(columnDictionaryId)
+  {
+    if (isList || type == ColumnType::String)
+      array.InitOffsets();
+    if (isList && type == ColumnType::String)
+      items.InitOffsets();
+  }
+};
+
+ColumnType GetColumnType(const ElementStore::Definition& definition)
+{
+  switch (definition.valueType)
+  {
+  case API_PropertyIntegerValueType:
+    return ColumnType::Int;
+  case API_PropertyRealValueType:
+    return ColumnType::Real;
+  case API_PropertyBooleanValueType:
+    return ColumnType::Bool;
+  default:
+    // Single strings are dictionary encoded, list items are stored as plain strings
+    return definition.IsList() ? ColumnType::String : ColumnType::DictionaryString;
+  }
+}
+
+std::string GetValueString(const ElementStore& store, const ElementStore::Value& value)
+{
+  switch (value.type)
+  {
+  case API_PropertyStringValueType:
+    return std::string(store.GetString(value));
+  case API_PropertyGuidValueType:
+  {
+    std::string text;
+    GuidFormatter::Append(text, store.GetGuid(value));
+    return text;
+  }
+  default:
+    return "";
+  }
+}
+
+void AppendStoredValue(ArrayBuilder& array, ColumnType type, const ElementStore& store, const ElementStore::Value& value)
+{
+  switch (type)
+  {
+  case ColumnType::Int:
+    array.AppendInt(true, value.intValue);
+    break;
+  case ColumnType::Real:
+    array.AppendReal(true, value.realValue);
+    break;
+  case ColumnType::Bool:
+    array.AppendBool(true, value.boolValue);
+    break;
+  default:
+    array.AppendString(true, GetValueString(store, value));
+    break;
+  }
+}
+
+void AppendNull(ArrayBuilder& array, ColumnType type)
+{
+  switch (type)
+  {
+  case ColumnType::Real:
+    array.AppendReal(false, 0.0);
+    break;
+  case ColumnType::Bool:
+    array.AppendBool(false, false);
+    break;
+  case ColumnType::String:
+    array.AppendString(false, "");
+    break;
+  default:
+    array.AppendInt(false, 0);
+    break;
+  }
+}
+
+void AppendProperty(Column& column, const ElementStore& store, const ElementStore::Property* prop)
+{
+  // Properties missing from the element or without a value are stored as nulls. Columns are created from the
+  // shared definitions, so the types of the property and column always match.
+  bool isValid = prop != nullptr && prop->hasValue;
+
+  if (column.isList)
+  {
+    if (isValid)
+    {
+      for (UInt32 i = prop->firstValue; i < prop->firstValue + prop->valueCount; ++i)
+        AppendStoredValue(column.items, column.type, store, store.GetValue(i));
+    }
+    column.array.AppendOffset(column.items.length);
+    column.array.AppendValidity(isValid);
+  }
+  else if (!isValid)
+  {
+    AppendNull(column.array, column.type);
+  }
+  else if (column.type == ColumnType::DictionaryString)
+  {
+    column.array.AppendInt(true, column.dictionary.GetIndex(GetValueString(store, store.GetValue(prop->firstValue))));
+  }
+  else
+  {
+    AppendStoredValue(column.array, column.type, store, store.GetValue(prop->firstValue));
+  }
+}
+
+FlatBufferBuilder::Offset BuildType(FlatBufferBuilder& builder, ColumnType type, bool isLarge, uint8_t& typeId)
+{
+  builder.StartTable();
+  switch (type)
+  {
+  case ColumnType::Int:
+    builder.AddField<int32_t>(0, 32);  // bitWidth
+    builder.AddField<uint8_t>(1, 1);   // is_signed
+    typeId = TypeInt;
+    break;
+  case ColumnType::Real:
+    builder.AddField<int16_t>(0, PrecisionDouble);
+    typeId = TypeFloatingPoint;
+    break;
+  case ColumnType::Bool:
+    typeId = TypeBool;
+    break;
+  default:
+    typeId = isLarge ? TypeLargeUtf8 : TypeUtf8;
+    break;
+  }
+  return builder.EndTable();
+}
+
+FlatBufferBuilder::Offset BuildField(FlatBufferBuilder& builder, const std::string& name, bool isNullable, uint8_t typeId, FlatBufferBuilder::Offset type, FlatBufferBuilder::Offset dictionary, const std::vector<FlatBufferBuilder::Offset>& children)
+{
+  FlatBufferBuilder::Offset nameOffset = builder.CreateString(name);
+  FlatBufferBuilder::Offset childrenOffset = builder.CreateOffsetVector(children);
+
+  builder.StartTable();
+  builder.AddOffsetField(0, nameOffset);
+  builder.AddField<uint8_t>(1, isNullable ? 1 : 0);
+  builder.AddField<uint8_t>(2, typeId);
+  builder.AddOffsetField(3, type);
+  if (dictionary != 0)
+    builder.AddOffsetField(4, dictionary);
+  builder.AddOffsetField(5, childrenOffset);
+  return builder.EndTable();
+}
+
+FlatBufferBuilder::Offset BuildColumnField(FlatBufferBuilder& builder, const Column& column)
+{
+  // Strings are held in the items of lists, the values of dictionaries, or the column itself
+  bool isLargeString = column.isList ? column.items.isLarge : column.dictionaryId >= 0 ? column.dictionary.values.isLarge : column.array.isLarge;
+  uint8_t typeId;
+  FlatBufferBuilder::Offset type = BuildType(builder, column.type, isLargeString, typeId);
+
+  if (column.isList)
+  {
+    FlatBufferBuilder::Offset item = BuildField(builder, "item", true, typeId, type, 0, {});
+    builder.StartTable();
+    FlatBufferBuilder::Offset listType = builder.EndTable();
+    return BuildField(builder, column.name, column.isNullable, column.array.isLarge ? TypeLargeList : TypeList, listType, 0, { item });
+  }
+
+  FlatBufferBuilder::Offset dictionary = 0;
+  if (column.dictionaryId >= 0)
+  {
+    uint8_t indexTypeId;
+    FlatBufferBuilder::Offset indexType = BuildType(builder, ColumnType::Int, false, indexTypeId);
+
+    builder.StartTable();
+    builder.AddField<int64_t>(0, column.dictionaryId);
+    builder.AddOffsetField(1, indexType);
+    builder.AddField<uint8_t>(2, 0);  // isOrdered
+    dictionary = builder.EndTable();
+  }
+  return BuildField(builder, column.name, column.isNullable, typeId, type, dictionary, {});
+}
+
+FlatBufferBuilder::Offset BuildSchema(FlatBufferBuilder& builder, const std::vector<Column>& columns)
+{
+  std::vector<FlatBufferBuilder::Offset> fields;
+  for (const Column& column : columns)
+    fields.push_back(BuildColumnField(builder, column));
+  FlatBufferBuilder::Offset fieldsOffset = builder.CreateOffsetVector(fields);
+
+  builder.StartTable();
+  builder.AddField<int16_t>(0, 0);  // little endian
+  builder.AddOffsetField(1, fieldsOffset);
+  return builder.EndTable();
+}
+
+/**
+ * @brief Collects the field nodes and 8-byte aligned buffers making up the body of a record batch
+ */
+struct MessageBody
+{
+  std::vector<FieldNode> nodes;
+  std::vector<BufferLocation> buffers;
+  std::string bytes;
+
+  void AddBuffer(const std::string& buffer)
+  {
+    buffers.push_back({ static_cast<int64_t>(bytes.size()), static_cast<int64_t>(buffer.size()) });
+    bytes.append(buffer);
+    bytes.append((ArrowAlignment - bytes.size() % ArrowAlignment) % ArrowAlignment, '\0');
+  }
+
+  void AddArray(const ArrayBuilder& array, bool hasData)
+  {
+    // Validity bitmaps may be omitted when an array has no nulls
+    nodes.push_back({ array.length, array.nullCount });
+    AddBuffer(array.nullCount > 0 ? array.validity : std::string());
+    AddBuffer(array.values);
+    if (hasData)
+      AddBuffer(array.data);
+  }
+
+  void AddColumn(const Column& column)
+  {
+    if (column.isList)
+    {
+      AddArray(column.array, false);
+      AddArray(column.items, column.type == ColumnType::String);
+    }
+    else
+    {
+      AddArray(column.array, column.type == ColumnType::String);
+    }
+  }
+};
+
+FlatBufferBuilder::Offset BuildRecordBatch(FlatBufferBuilder& builder, int64_t length, const MessageBody& body)
+{
+  FlatBufferBuilder::Offset nodes = builder.CreateStructVector(body.nodes);
+  FlatBufferBuilder::Offset buffers = builder.CreateStructVector(body.buffers);
+
+  builder.StartTable();
+  builder.AddField<int64_t>(0, length);
+  builder.AddOffsetField(1, nodes);
+  builder.AddOffsetField(2, buffers);
+  return builder.EndTable();
+}
+
+std::string FinishMessage(FlatBufferBuilder& builder, uint8_t headerType, FlatBufferBuilder::Offset header, int64_t bodyLength)
+{
+  builder.StartTable();
+  builder.AddField<int16_t>(0, MetadataVersionV5);
+  builder.AddField<uint8_t>(1, headerType);
+  builder.AddOffsetField(2, header);
+  builder.AddField<int64_t>(3, bodyLength);
+  return builder.Finish(builder.EndTable());
+}
+
+/**
+ * @brief Writes an encapsulated IPC message, consisting of a continuation marker, the metadata length, the
+ * padded flatbuffer metadata and then the message body
+ */
+Block WriteMessage(std::string& output, const std::string& metadata, const std::string& body)
+{
+  Block block = {};
+  block.offset = static_cast<int64_t>(output.size());
+
+  size_t paddedLength = (metadata.size() + 2 * sizeof(int32_t) + ArrowAlignment - 1) / ArrowAlignment * ArrowAlignment;
+  AppendValue<uint32_t>(output, 0xFFFFFFFF);
+  AppendValue<int32_t>(output, static_cast<int32_t>(paddedLength - 2 * sizeof(int32_t)));
+  output.append(metadata);
+  output.append(paddedLength - 2 * sizeof(int32_t) - metadata.size(), '\0');
+  output.append(body);
+
+  block.metaDataLength = static_cast<int32_t>(paddedLength);
+  block.bodyLength = static_cast<int64_t>(body.size());
+  return block;
+}
+
+}
+
+/**
+ * @brief Serializes a collection of element and properties data into an Arrow IPC file. Each element becomes a row
+ * with guid, layer and type columns followed by a column for every property definition found on the elements.
+ * Rows are in the same canonical order as the json export and columns are ordered by name, so the same elements
+ * always produce the same bytes.
+ * @param[in] store The elements and property values to process
+ * @param[in] elemTypeNames The name of each element type, indexed by type id, resolved beforehand so that the
+ * serializer does not call the Archicad API
+ * @param[out] output The buffer to write the Arrow file to
+ */
+void ArrowSerializer::Serialize(const ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, ExportReport& report, std::string& output)
+{
+  ExportReport::ScopedPhase parsePhase(report, ExportPhase::Parse);
+  std::vector<Column> columns;
+  columns.emplace_back("guid", ColumnType::String, false, false, -1);
+  columns.emplace_back("layer", ColumnType::DictionaryString, false, false, 0);
+  columns.emplace_back("type", ColumnType::DictionaryString, false, false, 1);
+
+  // Create a column for each property definition in order of name and then guid, renaming any columns whose
+  // names are repeated, so the schema does not depend on the order the definitions were found in
+  std::vector<std::string> definitionNames;
+  std::vector<std::string> definitionGuidTexts;
+  std::vector<UInt32> definitionOrder(store.GetDefinitionCount());
+  for (UInt32 i = 0; i < store.GetDefinitionCount(); ++i)
+  {
+    const ElementStore::Definition& definition = store.GetDefinition(i);
+    definitionNames.push_back(definition.name.ToCStr(0, MaxUSize, CC_UTF8).Get());
+    definitionGuidTexts.emplace_back();
+    GuidFormatter::Append(definitionGuidTexts.back(), definition.guid);
+    definitionOrder[i] = i;
+  }
+  std::sort(definitionOrder.begin(), definitionOrder.end(), [&definitionNames, &definitionGuidTexts](UInt32 a, UInt32 b)
+  {
+    if (definitionNames[a] != definitionNames[b])
+      return definitionNames[a] < definitionNames[b];
+    return definitionGuidTexts[a] < definitionGuidTexts[b];
+  });
+
+  std::unordered_map<std::string, int> columnNameCounts = { { "guid", 1 }, { "layer", 1 }, { "type", 1 } };
+  std::vector<size_t> definitionColumns(store.GetDefinitionCount());
+  int64_t nextDictionaryId = 2;
+
+  for (UInt32 definitionIndex : definitionOrder)
+  {
+    const ElementStore::Definition& definition = store.GetDefinition(definitionIndex);
+    std::string name = definitionNames[definitionIndex];
+    if (columnNameCounts[name]++ > 0)
+      name += " (" + definitionGuidTexts[definitionIndex] + ")";
+
+    ColumnType type = GetColumnType(definition);
+    int64_t dictionaryId = type == ColumnType::DictionaryString ? nextDictionaryId++ : -1;
+    definitionColumns[definitionIndex] = columns.size();
+    columns.emplace_back(name, type, definition.IsList(), true, dictionaryId);
+  }
+
+  // Obtain the layer, type and guid text of each element
+  std::vector<std::string> layerNames(store.GetLayerCount());
+  for (UInt32 i = 0; i < store.GetLayerCount(); ++i)
+    layerNames[i] = store.GetLayerName(i).ToCStr(0, MaxUSize, CC_UTF8).Get();
+
+  std::vector<std::string> elemTypeTexts;
+  std::vector<std::array<char, GuidFormatter::Length>> elemGuidTexts(store.GetElementCount());
+  std::vector<UInt32> rowOrder(store.GetElementCount());
+  for (UInt32 elemIndex = 0; elemIndex < store.GetElementCount(); ++elemIndex)
+  {
+    size_t typeIndex = static_cast<size_t>(store.GetElementTypeId(elemIndex));
+    if (typeIndex >= elemTypeTexts.size())
+      elemTypeTexts.resize(typeIndex + 1);
+    if (elemTypeTexts[typeIndex].empty() && typeIndex < elemTypeNames.size())
+      elemTypeTexts[typeIndex] = elemTypeNames[typeIndex].ToCStr(0, MaxUSize, CC_UTF8).Get();
+
+    GuidFormatter::Format(store.GetElementGuid(elemIndex), elemGuidTexts[elemIndex].data());
+    rowOrder[elemIndex] = elemIndex;
+  }
+
+  // Sort rows into the same order as the json export: by layer name, then type name, then guid
+  auto getElemTypeName = [&store, &elemTypeTexts](UInt32 elemIndex) -> const std::string&
+  {
+    return elemTypeTexts[static_cast<size_t>(store.GetElementTypeId(elemIndex))];
+  };
+  std::stable_sort(rowOrder.begin(), rowOrder.end(), [&store, &layerNames, &getElemTypeName, &elemGuidTexts](UInt32 a, UInt32 b)
+  {
+    const std::string& layerA = layerNames[store.GetLayerIndex(a)];
+    const std::string& layerB = layerNames[store.GetLayerIndex(b)];
+    if (layerA != layerB)
+      return layerA < layerB;
+    if (getElemTypeName(a) != getElemTypeName(b))
+      return getElemTypeName(a) < getElemTypeName(b);
+    return elemGuidTexts[a] < elemGuidTexts[b];
+  });
+
+  // Fill the columns with a row for each element
+  std::vector<const ElementStore::Property*> rowProperties(store.GetDefinitionCount());
+  std::string elemGuidText;
+  int64_t rowCount = 0;
+
+  for (size_t row = 0; row < rowOrder.size(); ++row)
+  {
+    // Skip elements that are repeated later, the last occurrence is kept
+    UInt32 elemIndex = rowOrder[row];
+    if (row + 1 < rowOrder.size() && elemGuidTexts[rowOrder[row + 1]] == elemGuidTexts[elemIndex])
+      continue;
+
+    elemGuidText.assign(elemGuidTexts[elemIndex].data(), GuidFormatter::Length);
+    columns[0].array.AppendString(true, elemGuidText);
+    columns[1].array.AppendInt(true, columns[1].dictionary.GetIndex(layerNames[store.GetLayerIndex(elemIndex)]));
+    columns[2].array.AppendInt(true, columns[2].dictionary.GetIndex(getElemTypeName(elemIndex)));
+
+    std::fill(rowProperties.begin(), rowProperties.end(), nullptr);
+    for (UInt32 i = store.GetFirstProperty(elemIndex); i < store.GetPropertyEnd(elemIndex); ++i)
+      rowProperties[store.GetProperty(i).definitionIndex] = &store.GetProperty(i);
+
+    for (UInt32 i = 0; i < store.GetDefinitionCount(); ++i)
+      AppendProperty(columns[definitionColumns[i]], store, rowProperties[i]);
+
+    ++rowCount;
+  }
+
+  parsePhase.Stop();
+
+  // Write the file header and schema
+  ExportReport::ScopedPhase serializePhase(report, ExportPhase::Serialize);
+  std::vector<Block> dictionaryBlocks;
+  std::vector<Block> recordBatchBlocks;
+
+  output.append(ArrowMagic, sizeof(ArrowMagic) - 1);
+  output.append(ArrowAlignment - (sizeof(ArrowMagic) - 1), '\0');
+  {
+    FlatBufferBuilder builder;
+    FlatBufferBuilder::Offset schema = BuildSchema(builder, columns);
+    WriteMessage(output, FinishMessage(builder, MessageHeaderSchema, schema, 0), std::string());
+  }
+
+  // Write dictionaries, which must precede the record batches referencing them
+  for (const Column& column : columns)
+  {
+    if (column.dictionaryId < 0)
+      continue;
+
+    MessageBody body;
+    body.AddArray(column.dictionary.values, true);
+
+    FlatBufferBuilder builder;
+    FlatBufferBuilder::Offset data = BuildRecordBatch(builder, column.dictionary.values.length, body);
+    builder.StartTable();
+    builder.AddField<int64_t>(0, column.dictionaryId);
+    builder.AddOffsetField(1, data);
+    FlatBufferBuilder::Offset dictionaryBatch = builder.EndTable();
+
+    std::string metadata = FinishMessage(builder, MessageHeaderDictionaryBatch, dictionaryBatch, static_cast<int64_t>(body.bytes.size()));
+    dictionaryBlocks.push_back(WriteMessage(output, metadata, body.bytes));
+  }
+
+  // Write all rows as a single record batch
+  {
+    MessageBody body;
+    for (const Column& column : columns)
+      body.AddColumn(column);
+
+    FlatBufferBuilder builder;
+    FlatBufferBuilder::Offset recordBatch = BuildRecordBatch(builder, rowCount, body);
+    std::string metadata = FinishMessage(builder, MessageHeaderRecordBatch, recordBatch, static_cast<int64_t>(body.bytes.size()));
+    recordBatchBlocks.push_back(WriteMessage(output, metadata, body.bytes));
+  }
+
+  // Write the end of stream marker, followed by the file footer
+  AppendValue<uint32_t>(output, 0xFFFFFFFF);
+  AppendValue<int32_t>(output, 0);
+
+  FlatBufferBuilder builder;
+  FlatBufferBuilder::Offset schema = BuildSchema(builder, columns);
+  FlatBufferBuilder::Offset dictionaries = builder.CreateStructVector(dictionaryBlocks);
+  FlatBufferBuilder::Offset recordBatches = builder.CreateStructVector(recordBatchBlocks);
+  builder.StartTable();
+  builder.AddField<int16_t>(0, MetadataVersionV5);
+  builder.AddOffsetField(1, schema);
+  builder.AddOffsetField(2, dictionaries);
+  builder.AddOffsetField(3, recordBatches);
+  std::string footer = builder.Finish(builder.EndTable());
+
+  output.append(footer);
+  AppendValue<int32_t>(output, static_cast<int32_t>(footer.size()));
+  output.append(ArrowMagic, sizeof(ArrowMagic) - 1);
+}
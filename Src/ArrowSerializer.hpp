@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ACAPinc.h"
+#include "ElementStore.hpp"
+#include "ExportReport.hpp"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Serializes element data into the Apache Arrow IPC file format, with one row per element and one
+ * column per property definition. String columns are dictionary encoded and missing values are marked in
+ * null bitmaps, so the output can be loaded directly by Arrow readers without going through JSON.
+ */
+class ArrowSerializer {
+public:
+  ArrowSerializer() = delete; // prevent instantiation of this class
+
+  static void Serialize(const ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, ExportReport& report, std::string& output);
+};
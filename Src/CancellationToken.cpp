@@ -0,0 +1,53 @@
+#include "CancellationToken.hpp"
+
+CancellationToken::CancellationToken() :
+  m_isCancelled(false),
+  m_isStopped(false)
+{
+}
+
+void CancellationToken::Cancel()
+{
+  // Tokens are cancelled from one thread only, so the time can be set before the flag that publishes it to others
+  if (IsCancelled())
+    return;
+
+  m_cancelTime = std::chrono::steady_clock::now();
+  m_isCancelled.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief Checks whether cancellation has been requested. Safe to call from any thread.
+ * @returns True if the export should stop
+ */
+bool CancellationToken::IsCancelled() const
+{
+  return m_isCancelled.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Records that a cancelled export has stopped, before anything is shown to the user, so that the time it
+ * took to stop leaves out time spent on dialogs. Has no effect if the token is not cancelled, or after the first call.
+ */
+void CancellationToken::MarkStopped()
+{
+  if (!IsCancelled() || m_isStopped)
+    return;
+
+  m_stopTime = std::chrono::steady_clock::now();
+  m_isStopped = true;
+}
+
+/**
+ * @brief Obtains the time from cancellation being requested until the export stopped, used to report how quickly
+ * an export stops. An export not marked as stopped yet is timed until now.
+ * @returns The elapsed milliseconds, or zero if the token has not been cancelled
+ */
+double CancellationToken::GetStopMilliseconds() const
+{
+  if (!IsCancelled())
+    return 0.0;
+
+  std::chrono::steady_clock::time_point stopTime = m_isStopped ? m_stopTime : std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stopTime - m_cancelTime).count();
+}
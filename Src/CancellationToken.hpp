@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * @brief Signals that an export should stop at its next cancellation point. Cancellation is requested from the API
+ * thread between slices of an export, and can be checked from any thread, including workers writing or uploading
+ * the output. Waits on work that cannot check the token itself, such as a request in flight, check it every
+ * PollInterval.
+ */
+class CancellationToken {
+public:
+  static constexpr std::chrono::milliseconds PollInterval{ 50 };
+
+  CancellationToken();
+
+  void Cancel();
+  bool IsCancelled() const;
+  void MarkStopped();
+
+  double GetStopMilliseconds() const;
+
+private:
+  std::atomic<bool> m_isCancelled;
+  std::chrono::steady_clock::time_point m_cancelTime;
+  std::chrono::steady_clock::time_point m_stopTime;
+  bool m_isStopped;
+};
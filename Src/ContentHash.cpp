@@ -0,0 +1,147 @@
+#include "ContentHash.hpp"
+
+#include <cstring>
+
+namespace {
+
+const UInt64 Prime1 = 11400714785074694791ULL;
+const UInt64 Prime2 = 14029467366897019727ULL;
+const UInt64 Prime3 = 1609587929392839161ULL;
+const UInt64 Prime4 = 9650029242287828579ULL;
+const UInt64 Prime5 = 2870177450012600261ULL;
+
+UInt64 RotateLeft(UInt64 value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+UInt64 Read64(const unsigned char* bytes)
+{
+  UInt64 value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+UInt32 Read32(const unsigned char* bytes)
+{
+  UInt32 value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+UInt64 Round(UInt64 lane, UInt64 input)
+{
+  lane += input * Prime2;
+  return RotateLeft(lane, 31) * Prime1;
+}
+
+UInt64 MergeRound(UInt64 hash, UInt64 lane)
+{
+  hash ^= Round(0, lane);
+  return hash * Prime1 + Prime4;
+}
+
+}
+
+ContentHash::ContentHash() :
+  m_lanes{ Prime1 + Prime2, Prime2, 0, 0 - Prime1 },
+  m_buffer{},
+  m_bufferSize(0),
+  m_totalSize(0)
+{
+}
+
+/**
+ * @brief Adds a sequence of bytes to the hash. Whole 32-byte stripes are hashed as they arrive, and the remainder is
+ * kept until the next sequence completes it.
+ * @param[in] data The bytes to add
+ * @param[in] size The number of bytes
+ */
+void ContentHash::Append(const void* data, size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  const unsigned char* end = bytes + size;
+  m_totalSize += size;
+
+  if (m_bufferSize + size < StripeSize)
+  {
+    if (size > 0)
+      std::memcpy(m_buffer + m_bufferSize, bytes, size);
+    m_bufferSize += size;
+    return;
+  }
+
+  if (m_bufferSize > 0)
+  {
+    size_t fill = StripeSize - m_bufferSize;
+    std::memcpy(m_buffer + m_bufferSize, bytes, fill);
+    AppendStripe(m_buffer);
+    bytes += fill;
+    m_bufferSize = 0;
+  }
+
+  for (; end - bytes >= static_cast<std::ptrdiff_t>(StripeSize); bytes += StripeSize)
+    AppendStripe(bytes);
+
+  m_bufferSize = static_cast<size_t>(end - bytes);
+  if (m_bufferSize > 0)
+    std::memcpy(m_buffer, bytes, m_bufferSize);
+}
+
+/**
+ * @brief Obtains the hash of every byte added so far. Bytes can still be added afterwards.
+ */
+UInt64 ContentHash::GetValue() const
+{
+  UInt64 hash;
+  if (m_totalSize >= StripeSize)
+  {
+    hash = RotateLeft(m_lanes[0], 1) + RotateLeft(m_lanes[1], 7) + RotateLeft(m_lanes[2], 12) + RotateLeft(m_lanes[3], 18);
+    for (UInt64 lane : m_lanes)
+      hash = MergeRound(hash, lane);
+  }
+  else
+  {
+    hash = m_lanes[2] + Prime5;
+  }
+  hash += m_totalSize;
+
+  // Mix in the bytes that do not fill a stripe, eight, then four, then one at a time
+  const unsigned char* bytes = m_buffer;
+  const unsigned char* end = m_buffer + m_bufferSize;
+  for (; end - bytes >= 8; bytes += 8)
+    hash = RotateLeft(hash ^ Round(0, Read64(bytes)), 27) * Prime1 + Prime4;
+  if (end - bytes >= 4)
+  {
+    hash = RotateLeft(hash ^ (Read32(bytes) * Prime1), 23) * Prime2 + Prime3;
+    bytes += 4;
+  }
+  for (; bytes < end; ++bytes)
+    hash = RotateLeft(hash ^ (*bytes * Prime5), 11) * Prime1;
+
+  hash ^= hash >> 33;
+  hash *= Prime2;
+  hash ^= hash >> 29;
+  hash *= Prime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+/**
+ * @brief Hashes a single sequence of bytes
+ * @param[in] data The bytes to hash
+ * @param[in] size The number of bytes
+ * @returns The 64-bit hash
+ */
+UInt64 ContentHash::Compute(const void* data, size_t size)
+{
+  ContentHash hash;
+  hash.Append(data, size);
+  return hash.GetValue();
+}
+
+void ContentHash::AppendStripe(const unsigned char* stripe)
+{
+  for (size_t i = 0; i < 4; ++i)
+    m_lanes[i] = Round(m_lanes[i], Read64(stripe + i * 8));
+}
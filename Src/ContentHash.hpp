@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ACAPinc.h"
+
+#include <cstddef>
+
+/**
+ * @brief Computes 64-bit xxHash64 hashes of byte sequences, reading eight bytes at a time. A hash can be built up
+ * from several sequences in turn, giving the same result as hashing them joined together.
+ */
+class ContentHash {
+public:
+  ContentHash();
+
+  void Append(const void* data, size_t size);
+  UInt64 GetValue() const;
+
+  static UInt64 Compute(const void* data, size_t size);
+
+private:
+  static const size_t StripeSize = 32;
+
+  void AppendStripe(const unsigned char* stripe);
+
+  UInt64 m_lanes[4];
+  unsigned char m_buffer[StripeSize];
+  size_t m_bufferSize;
+  UInt64 m_totalSize;
+};
@@ -0,0 +1,46 @@
+#include "CpuFeatures.hpp"
+
+#if defined(EXPORT_SIMD_AVX2) && defined(_MSC_VER) && !defined(__clang__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+bool DetectAvx2()
+{
+#if !defined(EXPORT_SIMD_AVX2)
+  return false;
+#elif defined(__GNUC__) || defined(__clang__)
+  return __builtin_cpu_supports("avx2");
+#else
+  // The processor must support AVX2, and the OS must save the AVX registers on context switches
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+
+  __cpuid(info, 1);
+  const int OsxsaveBit = 1 << 27;
+  const int AvxBit = 1 << 28;
+  if ((info[2] & OsxsaveBit) == 0 || (info[2] & AvxBit) == 0)
+    return false;
+  if ((_xgetbv(0) & 0x6) != 0x6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  const int Avx2Bit = 1 << 5;
+  return (info[1] & Avx2Bit) != 0;
+#endif
+}
+
+}
+
+/**
+ * @brief Determines if AVX2 code paths can be used. The processor is only queried on the first call.
+ * @returns True if the processor and OS support AVX2
+ */
+bool CpuFeatures::HasAvx2()
+{
+  static const bool hasAvx2 = DetectAvx2();
+  return hasAvx2;
+}
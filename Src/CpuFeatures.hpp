@@ -0,0 +1,48 @@
+#pragma once
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// SSE2 is part of every x86-64 target, and of 32-bit x86 targets built with it enabled
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EXPORT_SIMD_SSE2
+#endif
+
+// AVX2 code paths are compiled alongside the baseline and selected at runtime on processors supporting them
+#if defined(EXPORT_SIMD_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define EXPORT_SIMD_AVX2
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define EXPORT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define EXPORT_TARGET_AVX2
+#endif
+
+/**
+ * @brief Detects the instruction set extensions of the processor, for selecting vectorized code paths at runtime
+ */
+class CpuFeatures {
+public:
+  CpuFeatures() = delete; // prevent instantiation of this class
+
+  static bool HasAvx2();
+  static unsigned int CountTrailingZeros(unsigned int mask);
+};
+
+/**
+ * @brief Obtains the index of the lowest set bit, e.g. of the first matching lane in a vector comparison mask
+ * @param[in] mask The mask to scan, which must not be zero
+ * @returns The index of the lowest set bit
+ */
+inline unsigned int CpuFeatures::CountTrailingZeros(unsigned int mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<unsigned int>(index);
+#else
+  return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
@@ -1,33 +1,131 @@
 #include "DataExporter.hpp"
+#include "TraceRecorder.hpp"
 
 //#define CPPHTTPLIB_OPENSSL_SUPPORT
-#include "ThirdParty/httplib.h"
+#include "Thirdparty/httplib.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <filesystem>
+#include <future>
+
+namespace {
+
+// Data is written and uploaded in chunks of this size, checking for cancellation in between
+const size_t ChunkSize = 1024 * 1024;
+
+const char* CancelledErrorStr = "Export was cancelled";
+
+bool PostWithCancellation(httplib::Client& cli, size_t contentLength, httplib::ContentProvider contentProvider, const std::string& contentType, CancellationToken& cancellationToken, std::string& errorStr)
+{
+  // Send the request from a worker thread, so that it can be stopped if cancellation is requested while waiting on the server
+  std::future<httplib::Result> request = std::async(std::launch::async, [&cli, contentLength, &contentProvider, &contentType]()
+  {
+    return cli.Post("/post", contentLength, contentProvider, contentType);
+  });
+
+  while (request.wait_for(CancellationToken::PollInterval) != std::future_status::ready)
+  {
+    if (cancellationToken.IsCancelled())
+      cli.stop();
+  }
+
+  httplib::Result result = request.get();
+  if (cancellationToken.IsCancelled())
+  {
+    errorStr = CancelledErrorStr;
+    return false;
+  }
+
+  if (!result || result->status != httplib::StatusCode::OK_200)
+  {
+    errorStr = httplib::to_string(result.error());
+    return false;
+  }
+  return true;
+}
+
+}
 
 /**
- * @brief Writes a json structure to file. Constructs a new file if one does not already exist and will
- * overwrite existing ones.
- * @param[in] exportJson The json to export
+ * @brief Writes serialized data to file. Constructs a new file if one does not already exist and will
+ * overwrite existing ones. If cancelled part way through, the partially written file is removed. Data is written
+ * byte for byte, without translating new lines, so the file holds exactly the bytes that are hashed and uploaded.
+ * @param[in] exportData The serialized data to export
  * @param[in] filePath The path of the file to write to
- * @param[in] width The indent width for json elements
+ * @param[in] cancellationToken Token checked between each chunk of data written
  * @param[out] errorStr Error message output if export was unsuccessful
  * @returns True if file could be sucessfully opened
  */
-bool DataExporter::ExportToFile(const json& exportJson, const std::string& filePath, int width, std::string& errorStr)
+bool DataExporter::ExportToFile(const std::string& exportData, const std::string& filePath, CancellationToken& cancellationToken, std::string& errorStr)
+{
+  TraceRecorder::ScopedSpan span("Write file", "io");
+  span.SetArg("bytes", static_cast<Int64>(exportData.size()));
+
+  try
+  {
+    // Open a file and write data to it
+    std::ofstream outFile(filePath, std::ofstream::binary | std::ofstream::trunc);
+    if (!outFile.is_open())
+    {
+      errorStr = "";
+      return false;
+    }
+
+    for (size_t offset = 0; offset < exportData.size(); offset += ChunkSize)
+    {
+      if (cancellationToken.IsCancelled())
+      {
+        outFile.close();
+        std::error_code errorCode;
+        std::filesystem::remove(filePath, errorCode);
+        errorStr = CancelledErrorStr;
+        return false;
+      }
+      outFile.write(exportData.data() + offset, std::min(ChunkSize, exportData.size() - offset));
+    }
+
+    outFile.close();
+  }
+  catch (std::exception& e)
+  {
+    errorStr = e.what();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Writes a chunk of serialized data to file byte for byte, for exports that are written incrementally
+ * @param[in] exportData The serialized data to write
+ * @param[in] filePath The path of the file to write to
+ * @param[in] append If true, data is added to the end of the file, otherwise the file is overwritten
+ * @param[in] cancellationToken Token checked before the chunk is written
+ * @param[out] errorStr Error message output if export was unsuccessful
+ * @returns True if file could be sucessfully written to
+ */
+bool DataExporter::ExportChunkToFile(const std::string& exportData, const std::string& filePath, bool append, CancellationToken& cancellationToken, std::string& errorStr)
 {
+  TraceRecorder::ScopedSpan span("Write file chunk", "io");
+  span.SetArg("bytes", static_cast<Int64>(exportData.size()));
+
+  if (cancellationToken.IsCancelled())
+  {
+    errorStr = CancelledErrorStr;
+    return false;
+  }
+
   try
   {
-    // Open a file and write JSON to it
-    std::ofstream outFile(filePath, std::ofstream::trunc);
+    std::ofstream outFile(filePath, std::ofstream::binary | (append ? std::ofstream::app : std::ofstream::trunc));
     if (!outFile.is_open())
     {
       errorStr = "";
       return false;
     }
 
-    outFile << std::setw(width) << exportJson << std::endl;
+    outFile.write(exportData.data(), exportData.size());
     outFile.close();
   }
   catch (std::exception& e)
@@ -39,36 +137,97 @@ bool DataExporter::ExportToFile(const json& exportJson, const std::string& fileP
 }
 
 /**
- * @brief Writes a json structure to a url
- * @param[in] exportJson The json to export
+ * @brief Writes serialized data to a url
+ * @param[in] exportData The serialized data to export
  * @param[in] linkPath The link to send a POST message to
- * @param[in] width The indent width for json elements
+ * @param[in] contentType The MIME type of the data
+ * @param[in] cancellationToken Token checked while the request is in flight, stopping it if cancelled
  * @param[out] errorStr Error message output if export was unsuccessful
  * @returns True if the data could be successfully sent
  */
-bool DataExporter::ExportToUrl(const json& exportJson, const std::string& baseUrl, int width, std::string& errorStr)
+bool DataExporter::ExportToUrl(const std::string& exportData, const std::string& baseUrl, const std::string& contentType, CancellationToken& cancellationToken, std::string& errorStr)
 {
-  // Clip last slash in case it was left on
-  std::string baseUrlStr = baseUrl;
-  if (baseUrlStr.back() == '/')
-    baseUrlStr = baseUrlStr.substr(0, baseUrl.size() - 1);
+  std::string baseUrlStr = TrimBaseUrl(baseUrl);
 
   try
   {
-    // Open a connection and post JSON to the url endpoint
+    // Open a connection and post data to the url endpoint, supplying it a chunk at a time
+    TraceRecorder::ScopedSpan span("Upload request", "io");
+    span.SetArg("bytes", static_cast<Int64>(exportData.size()));
+
     httplib::Client cli(baseUrlStr);
-    httplib::Result result = cli.Post("/post", exportJson.dump(width), "application/json");
+    return PostWithCancellation(cli, exportData.size(), [&exportData, &cancellationToken](size_t offset, size_t length, httplib::DataSink& sink)
+    {
+      if (cancellationToken.IsCancelled())
+        return false;
+
+      sink.write(exportData.data() + offset, std::min(length, ChunkSize));
+      return true;
+    }, contentType, cancellationToken, errorStr);
+  }
+  catch (std::exception& e)
+  {
+    errorStr = e.what();
+    return false;
+  }
+}
 
-    if (!result || result->status != httplib::StatusCode::OK_200)
+/**
+ * @brief Uploads the contents of a file to a url, reading it in chunks so the file is never held in memory
+ * @param[in] filePath The path of the file to upload
+ * @param[in] baseUrl The link to send a POST message to
+ * @param[in] contentType The MIME type of the data
+ * @param[in] cancellationToken Token checked while the request is in flight, stopping it if cancelled
+ * @param[out] errorStr Error message output if export was unsuccessful
+ * @returns True if the data could be successfully sent
+ */
+bool DataExporter::ExportFileToUrl(const std::string& filePath, const std::string& baseUrl, const std::string& contentType, CancellationToken& cancellationToken, std::string& errorStr)
+{
+  std::string baseUrlStr = TrimBaseUrl(baseUrl);
+
+  try
+  {
+    std::ifstream inFile(filePath, std::ifstream::binary);
+    if (!inFile.is_open())
     {
-      errorStr = httplib::to_string(result.error());
+      errorStr = "Unable to open " + filePath;
       return false;
     }
+    size_t fileSize = static_cast<size_t>(std::filesystem::file_size(filePath));
+
+    // Open a connection and post the file to the url endpoint, supplying it a chunk at a time
+    TraceRecorder::ScopedSpan span("Upload request", "io");
+    span.SetArg("bytes", static_cast<Int64>(fileSize));
+
+    httplib::Client cli(baseUrlStr);
+    std::vector<char> chunk(ChunkSize);
+    return PostWithCancellation(cli, fileSize, [&inFile, &chunk, &cancellationToken](size_t offset, size_t length, httplib::DataSink& sink)
+    {
+      if (cancellationToken.IsCancelled())
+        return false;
+
+      inFile.seekg(static_cast<std::streamoff>(offset));
+      inFile.read(chunk.data(), static_cast<std::streamsize>(std::min(length, chunk.size())));
+      if (inFile.gcount() <= 0)
+        return false;
+
+      sink.write(chunk.data(), static_cast<size_t>(inFile.gcount()));
+      return true;
+    }, contentType, cancellationToken, errorStr);
   }
   catch (std::exception& e)
   {
     errorStr = e.what();
     return false;
   }
-  return true;
+}
+
+std::string DataExporter::TrimBaseUrl(const std::string& baseUrl)
+{
+  // Clip last slash in case it was left on
+  std::string baseUrlStr = baseUrl;
+  if (!baseUrlStr.empty() && baseUrlStr.back() == '/')
+    baseUrlStr.pop_back();
+
+  return baseUrlStr;
 }
@@ -1,13 +1,18 @@
 #pragma once
 
-#include "Thirdparty/json.hpp"
+#include "CancellationToken.hpp"
 
-using json = nlohmann::json;
+#include <string>
 
 class DataExporter {
 public:
   DataExporter() = delete; // prevent instantiation of this class
 
-  static bool ExportToFile(const json& exportJson, const std::string& filePath, int width, std::string& errorStr);
-  static bool ExportToUrl(const json& exportJson, const std::string& baseUrl, int width, std::string& errorStr);
+  static bool ExportToFile(const std::string& exportData, const std::string& filePath, CancellationToken& cancellationToken, std::string& errorStr);
+  static bool ExportChunkToFile(const std::string& exportData, const std::string& filePath, bool append, CancellationToken& cancellationToken, std::string& errorStr);
+  static bool ExportToUrl(const std::string& exportData, const std::string& baseUrl, const std::string& contentType, CancellationToken& cancellationToken, std::string& errorStr);
+  static bool ExportFileToUrl(const std::string& filePath, const std::string& baseUrl, const std::string& contentType, CancellationToken& cancellationToken, std::string& errorStr);
+
+private:
+  static std::string TrimBaseUrl(const std::string& baseUrl);
 };
@@ -0,0 +1,84 @@
+#include "ElementFilter.hpp"
+
+/**
+ * @brief Constructs a filter from the export settings. Filters that are not enabled in the settings include every
+ * element.
+ * @param[in] settingsData The settings holding the storey range, layer visibility and classification filters
+ */
+ElementFilter::ElementFilter(const JsonExportSettingsData& settingsData) :
+  m_filterStoreys(settingsData.filterStoreys),
+  m_minStorey(settingsData.minStorey),
+  m_maxStorey(settingsData.maxStorey),
+  m_visibleLayersOnly(settingsData.visibleLayersOnly)
+{
+  for (const GS::UniString& classification : settingsData.classifications)
+  {
+    if (!classification.IsEmpty())
+      m_classifications.Add(classification);
+  }
+}
+
+/**
+ * @brief Determines if an element's storey is within the storey range
+ * @param[in] header The header of the element
+ * @returns True if storeys are not filtered or the element's storey index is within the range
+ */
+bool ElementFilter::IsStoreyIncluded(const API_Elem_Head& header) const
+{
+  return !m_filterStoreys || (header.floorInd >= m_minStorey && header.floorInd <= m_maxStorey);
+}
+
+/**
+ * @brief Determines if elements on a layer are included
+ * @param[in] isLayerHidden True if the layer is hidden
+ * @returns True if layers are not filtered or the layer is visible
+ */
+bool ElementFilter::IsLayerIncluded(bool isLayerHidden) const
+{
+  return !m_visibleLayersOnly || !isLayerHidden;
+}
+
+/**
+ * @brief Determines if an element is classified as one of the filtered classifications. Whether each
+ * classification item matches is looked up once and reused for every element classified with it.
+ * @param[in] elemGuid The guid of the element
+ * @param[out] report The report to count classification item lookups in
+ * @returns True if classifications are not filtered or one of the element's items has a filtered id or name
+ */
+bool ElementFilter::IsClassificationIncluded(const API_Guid& elemGuid, ExportReport& report)
+{
+  if (m_classifications.IsEmpty())
+    return true;
+
+  // Items are paired with the classification system they belong to
+  GS::Array<GS::Pair<API_Guid, API_Guid>> systemItemPairs;
+  if (ACAPI_Element_GetClassificationItems(elemGuid, systemItemPairs) != NoError)
+    return false;
+
+  for (const GS::Pair<API_Guid, API_Guid>& systemItemPair : systemItemPairs)
+  {
+    if (IsClassificationItemIncluded(systemItemPair.second, report))
+      return true;
+  }
+  return false;
+}
+
+bool ElementFilter::IsClassificationItemIncluded(const API_Guid& itemGuid, ExportReport& report)
+{
+  const GS::Guid& guid = APIGuid2GSGuid(itemGuid);
+  if (const bool* isIncluded = m_itemInclusions.GetPtr(guid))
+  {
+    report.AddCount(ExportCounter::ClassificationCacheHits);
+    return *isIncluded;
+  }
+  report.AddCount(ExportCounter::ClassificationCacheMisses);
+
+  API_ClassificationItem item;
+  item.guid = itemGuid;
+  bool isIncluded =
+    ACAPI_Classification_GetClassificationItem(item) == NoError &&
+    (m_classifications.Contains(item.id) || m_classifications.Contains(item.name));
+
+  m_itemInclusions.Add(guid, isIncluded);
+  return isIncluded;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ACAPinc.h"
+#include "ExportReport.hpp"
+#include "JsonExportSettingsData.hpp"
+
+/**
+ * @brief Filters elements by storey, layer visibility and classification, so that elements left out of an export
+ * are discarded before their property definitions and values are requested. Storeys and layers are checked against
+ * the element header, and classifications against the ids and names of the element's classification items.
+ */
+class ElementFilter {
+public:
+  explicit ElementFilter(const JsonExportSettingsData& settingsData);
+
+  bool IsStoreyIncluded(const API_Elem_Head& header) const;
+  bool IsLayerIncluded(bool isLayerHidden) const;
+  bool IsClassificationIncluded(const API_Guid& elemGuid, ExportReport& report);
+
+private:
+  bool IsClassificationItemIncluded(const API_Guid& itemGuid, ExportReport& report);
+
+  bool m_filterStoreys;
+  Int32 m_minStorey;
+  Int32 m_maxStorey;
+  bool m_visibleLayersOnly;
+  GS::HashSet<GS::UniString> m_classifications;
+  GS::HashTable<GS::Guid, bool> m_itemInclusions;
+};
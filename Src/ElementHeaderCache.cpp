@@ -0,0 +1,71 @@
+#include "ElementHeaderCache.hpp"
+
+/**
+ * @brief Obtains the header of an element, fetching and holding onto it if it has not been fetched already
+ * @param[in] elemGuid The guid of the element
+ * @param[out] header The header of the element
+ * @param[out] report The report to count header fetches in
+ * @returns False if the header could not be fetched
+ */
+bool ElementHeaderCache::GetHeader(const API_Guid& elemGuid, API_Elem_Head& header, ExportReport& report)
+{
+  const GS::Guid& guid = APIGuid2GSGuid(elemGuid);
+  if (const API_Elem_Head* cachedHeader = m_headers.GetPtr(guid))
+  {
+    header = *cachedHeader;
+    return true;
+  }
+
+  if (!FetchHeader(elemGuid, header, report))
+    return false;
+
+  m_headers.Add(guid, header);
+  report.GetMemory().Allocate(MemoryCategory::ElementData, sizeof(API_Elem_Head));
+  return true;
+}
+
+/**
+ * @brief Obtains the header of an element for the last time, releasing it from the cache. Headers that have not
+ * been fetched already are fetched without being held.
+ * @param[in] elemGuid The guid of the element
+ * @param[out] header The header of the element
+ * @param[out] report The report to count header fetches in
+ * @returns False if the header could not be fetched
+ */
+bool ElementHeaderCache::TakeHeader(const API_Guid& elemGuid, API_Elem_Head& header, ExportReport& report)
+{
+  const GS::Guid& guid = APIGuid2GSGuid(elemGuid);
+  if (const API_Elem_Head* cachedHeader = m_headers.GetPtr(guid))
+  {
+    header = *cachedHeader;
+    m_headers.Delete(guid);
+    report.GetMemory().Release(MemoryCategory::ElementData, sizeof(API_Elem_Head));
+    return true;
+  }
+
+  return FetchHeader(elemGuid, header, report);
+}
+
+/**
+ * @brief Releases the header of an element that is no longer needed by the export
+ * @param[in] elemGuid The guid of the element
+ * @param[out] report The report to release the header's memory from
+ */
+void ElementHeaderCache::ReleaseHeader(const API_Guid& elemGuid, ExportReport& report)
+{
+  if (m_headers.Delete(APIGuid2GSGuid(elemGuid)))
+    report.GetMemory().Release(MemoryCategory::ElementData, sizeof(API_Elem_Head));
+}
+
+UInt64 ElementHeaderCache::GetMemorySize() const
+{
+  return static_cast<UInt64>(m_headers.GetSize()) * sizeof(API_Elem_Head);
+}
+
+bool ElementHeaderCache::FetchHeader(const API_Guid& elemGuid, API_Elem_Head& header, ExportReport& report)
+{
+  BNZeroMemory(&header, sizeof(API_Elem_Head));
+  header.guid = elemGuid;
+  report.AddCount(ExportCounter::HeaderFetches);
+  return ACAPI_Element_GetHeader(&header) == NoError;
+}
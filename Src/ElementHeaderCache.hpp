@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ACAPinc.h"
+#include "ExportReport.hpp"
+
+/**
+ * @brief Headers of the elements of a single export, so that each header is fetched from Archicad at most once
+ * even when several stages of the export need it. Headers are held from the stage that first fetches them until
+ * they are taken by the stage that last uses them.
+ */
+class ElementHeaderCache {
+public:
+  bool GetHeader(const API_Guid& elemGuid, API_Elem_Head& header, ExportReport& report);
+  bool TakeHeader(const API_Guid& elemGuid, API_Elem_Head& header, ExportReport& report);
+  void ReleaseHeader(const API_Guid& elemGuid, ExportReport& report);
+  UInt64 GetMemorySize() const;
+
+private:
+  static bool FetchHeader(const API_Guid& elemGuid, API_Elem_Head& header, ExportReport& report);
+
+  GS::HashTable<GS::Guid, API_Elem_Head> m_headers;
+};
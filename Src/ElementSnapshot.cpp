@@ -0,0 +1,274 @@
+#include "ElementSnapshot.hpp"
+#include "ContentHash.hpp"
+#include "GuidFormatter.hpp"
+#include "JsonParser.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+template <typename T>
+void AppendValue(ContentHash& hash, const T& value)
+{
+  hash.Append(&value, sizeof(T));
+}
+
+void AppendText(ContentHash& hash, std::string_view text)
+{
+  // Prefix the length, so that consecutive texts hash differently to their concatenation
+  AppendValue(hash, text.size());
+  hash.Append(text.data(), text.size());
+}
+
+}
+
+/**
+ * @brief Builds a snapshot from a store of exported elements, interning their names and ordering their properties
+ * @param[in] store The store of elements and property values, which is taken over by the snapshot
+ * @param[in] elemTypeNames The name of each element type, indexed by type id. Types outside it have no name.
+ * @param[in] realDecimalPlaces The number of decimal places real values are rounded to, or a negative number to
+ * write them in full
+ */
+ElementSnapshot::ElementSnapshot(ElementStore&& store, const std::vector<GS::UniString>& elemTypeNames, Int32 realDecimalPlaces) :
+  m_store(std::move(store)),
+  m_realDecimalPlaces(realDecimalPlaces),
+  m_tag(0)
+{
+  for (UInt32 i = 0; i < m_store.GetDefinitionCount(); ++i)
+    m_definitionNameIds.push_back(m_strings.Intern(m_store.GetDefinition(i).name));
+  for (UInt32 i = 0; i < m_store.GetLayerCount(); ++i)
+    m_layerNameIds.push_back(m_strings.Intern(m_store.GetLayerName(i)));
+  for (UInt32 i = 0; i < m_store.GetElementCount(); ++i)
+  {
+    size_t elemTypeIndex = static_cast<size_t>(m_store.GetElementTypeId(i));
+    m_elemTypeNameIds.push_back(m_strings.Intern(elemTypeIndex < elemTypeNames.size() ? elemTypeNames[elemTypeIndex] : GS::UniString()));
+  }
+  m_strings.GetSortRanks(m_sortRanks);
+
+  // Order elements by guid text, keeping the last occurrence of elements that are repeated
+  std::vector<std::string> guidTexts(m_store.GetElementCount());
+  for (UInt32 i = 0; i < m_store.GetElementCount(); ++i)
+    GuidFormatter::Append(guidTexts[i], m_store.GetElementGuid(i));
+
+  std::vector<UInt32> order(m_store.GetElementCount());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&guidTexts](UInt32 a, UInt32 b)
+  {
+    return guidTexts[a] < guidTexts[b];
+  });
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    if (i + 1 == order.size() || guidTexts[order[i + 1]] != guidTexts[order[i]])
+      m_elemOrder.push_back(order[i]);
+  }
+
+  // Order each element's properties by name as the json export does, keeping one property per name
+  std::vector<UInt32> definitionRanks;
+  JsonParser::GetDefinitionRanks(m_store, m_definitionNameIds, m_sortRanks, definitionRanks);
+  m_propertyOffsets.push_back(0);
+  for (UInt32 i = 0; i < m_store.GetElementCount(); ++i)
+  {
+    std::vector<UInt32> properties(m_store.GetPropertyEnd(i) - m_store.GetFirstProperty(i));
+    std::iota(properties.begin(), properties.end(), m_store.GetFirstProperty(i));
+    std::stable_sort(properties.begin(), properties.end(), [this, &definitionRanks](UInt32 a, UInt32 b)
+    {
+      return definitionRanks[m_store.GetProperty(a).definitionIndex] < definitionRanks[m_store.GetProperty(b).definitionIndex];
+    });
+
+    for (size_t j = 0; j < properties.size(); ++j)
+    {
+      UInt32 nameId = m_definitionNameIds[m_store.GetProperty(properties[j]).definitionIndex];
+      if (j + 1 == properties.size() || m_definitionNameIds[m_store.GetProperty(properties[j + 1]).definitionIndex] != nameId)
+        m_propertyOrder.push_back(properties[j]);
+    }
+    m_propertyOffsets.push_back(static_cast<UInt32>(m_propertyOrder.size()));
+  }
+
+  m_tag = ComputeTag();
+}
+
+std::uint64_t ElementSnapshot::GetTag() const
+{
+  return m_tag;
+}
+
+UInt32 ElementSnapshot::GetElementCount() const
+{
+  return static_cast<UInt32>(m_elemOrder.size());
+}
+
+std::int32_t ElementSnapshot::GetRealDecimalPlaces() const
+{
+  return m_realDecimalPlaces;
+}
+
+/**
+ * @brief Finds the elements matching a query, in guid order
+ * @param[in] query The element types and layers to find elements of
+ * @param[out] elemIndices The indices of the matching elements
+ */
+void ElementSnapshot::FindElements(const Query& query, std::vector<std::uint32_t>& elemIndices) const
+{
+  std::vector<bool> elemTypeMask;
+  std::vector<bool> layerMask;
+  GetNameMask(query.elemTypeNames, elemTypeMask);
+  GetNameMask(query.layerNames, layerMask);
+
+  for (UInt32 elemIndex : m_elemOrder)
+  {
+    if (elemTypeMask[m_elemTypeNameIds[elemIndex]] && layerMask[m_layerNameIds[m_store.GetLayerIndex(elemIndex)]])
+      elemIndices.push_back(elemIndex);
+  }
+}
+
+/**
+ * @brief Determines which property names are to be written for a query
+ * @param[in] query The property names requested
+ * @param[out] nameMask Whether each interned name is requested, to be passed to WriteElement
+ */
+void ElementSnapshot::GetPropertyMask(const Query& query, std::vector<bool>& nameMask) const
+{
+  GetNameMask(query.propertyNames, nameMask);
+}
+
+/**
+ * @brief Writes an element as an object holding its guid, type, layer and requested properties
+ * @param[in] elemIndex The index of the element, as found by FindElements
+ * @param[in] nameMask The property names to write, as given by GetPropertyMask
+ * @param[out] writer The json writer to write to
+ */
+void ElementSnapshot::WriteElement(std::uint32_t elemIndex, const std::vector<bool>& nameMask, JsonWriter& writer) const
+{
+  writer.BeginObject();
+  writer.WriteKey("\"guid\"");
+  writer.WriteGuid(m_store.GetElementGuid(elemIndex));
+  writer.WriteKey("\"type\"");
+  writer.WriteString(m_strings.GetText(m_elemTypeNameIds[elemIndex]));
+  writer.WriteKey("\"layer\"");
+  writer.WriteString(m_strings.GetText(m_layerNameIds[m_store.GetLayerIndex(elemIndex)]));
+
+  writer.WriteKey("\"properties\"");
+  writer.BeginObject();
+  for (UInt32 i = m_propertyOffsets[elemIndex]; i < m_propertyOffsets[elemIndex + 1]; ++i)
+  {
+    const ElementStore::Property& prop = m_store.GetProperty(m_propertyOrder[i]);
+    UInt32 nameId = m_definitionNameIds[prop.definitionIndex];
+    if (!nameMask[nameId])
+      continue;
+
+    writer.WriteKey(m_strings.GetKey(nameId));
+    JsonParser::ParseJsonFromProperty(m_store, prop, writer);
+  }
+  writer.EndObject();
+  writer.EndObject();
+}
+
+/**
+ * @brief Writes an array of the element types in the snapshot, with the number of elements of each
+ * @param[out] writer The json writer to write to
+ */
+void ElementSnapshot::WriteTypes(JsonWriter& writer) const
+{
+  WriteNameCounts(m_elemTypeNameIds, writer);
+}
+
+/**
+ * @brief Writes an array of the layers in the snapshot, with the number of elements on each
+ * @param[out] writer The json writer to write to
+ */
+void ElementSnapshot::WriteLayers(JsonWriter& writer) const
+{
+  std::vector<UInt32> elemLayerNameIds(m_store.GetElementCount());
+  for (UInt32 i = 0; i < m_store.GetElementCount(); ++i)
+    elemLayerNameIds[i] = m_layerNameIds[m_store.GetLayerIndex(i)];
+  WriteNameCounts(elemLayerNameIds, writer);
+}
+
+void ElementSnapshot::GetNameMask(const std::vector<std::string>& names, std::vector<bool>& nameMask) const
+{
+  nameMask.assign(m_strings.GetSize(), names.empty());
+  for (UInt32 i = 0; i < m_strings.GetSize() && !names.empty(); ++i)
+    nameMask[i] = std::find(names.begin(), names.end(), m_strings.GetText(i)) != names.end();
+}
+
+void ElementSnapshot::WriteNameCounts(const std::vector<UInt32>& elemNameIds, JsonWriter& writer) const
+{
+  // Count the elements with each name, listing the names in key order
+  std::vector<UInt32> counts(m_strings.GetSize(), 0);
+  for (UInt32 elemIndex : m_elemOrder)
+    ++counts[elemNameIds[elemIndex]];
+
+  std::vector<UInt32> nameIds;
+  for (UInt32 i = 0; i < counts.size(); ++i)
+  {
+    if (counts[i] > 0)
+      nameIds.push_back(i);
+  }
+  std::sort(nameIds.begin(), nameIds.end(), [this](UInt32 a, UInt32 b)
+  {
+    return m_sortRanks[a] < m_sortRanks[b];
+  });
+
+  writer.BeginArray();
+  for (UInt32 nameId : nameIds)
+  {
+    writer.BeginObject();
+    writer.WriteKey("\"name\"");
+    writer.WriteString(m_strings.GetText(nameId));
+    writer.WriteKey("\"elements\"");
+    writer.WriteInt(static_cast<int>(counts[nameId]));
+    writer.EndObject();
+  }
+  writer.EndArray();
+}
+
+UInt64 ElementSnapshot::ComputeTag() const
+{
+  // Hash everything that can be written for an element, in the order it is written
+  ContentHash hash;
+  AppendValue(hash, m_realDecimalPlaces);
+  for (UInt32 elemIndex : m_elemOrder)
+  {
+    AppendValue(hash, m_store.GetElementGuid(elemIndex));
+    AppendText(hash, m_strings.GetText(m_elemTypeNameIds[elemIndex]));
+    AppendText(hash, m_strings.GetText(m_layerNameIds[m_store.GetLayerIndex(elemIndex)]));
+    AppendValue(hash, m_propertyOffsets[elemIndex + 1] - m_propertyOffsets[elemIndex]);
+
+    for (UInt32 i = m_propertyOffsets[elemIndex]; i < m_propertyOffsets[elemIndex + 1]; ++i)
+    {
+      const ElementStore::Property& prop = m_store.GetProperty(m_propertyOrder[i]);
+      const ElementStore::Definition& definition = m_store.GetDefinition(prop.definitionIndex);
+      AppendText(hash, m_strings.GetText(m_definitionNameIds[prop.definitionIndex]));
+      AppendValue(hash, definition.collectionType);
+      AppendValue(hash, prop.valueCount);
+
+      for (UInt32 j = prop.firstValue; j < prop.firstValue + prop.valueCount; ++j)
+      {
+        const ElementStore::Value& value = m_store.GetValue(j);
+        AppendValue(hash, value.type);
+        switch (value.type)
+        {
+        case API_PropertyIntegerValueType:
+          AppendValue(hash, value.intValue);
+          break;
+        case API_PropertyRealValueType:
+          AppendValue(hash, value.realValue);
+          break;
+        case API_PropertyBooleanValueType:
+          AppendValue(hash, value.boolValue);
+          break;
+        case API_PropertyStringValueType:
+          AppendText(hash, m_store.GetString(value));
+          break;
+        case API_PropertyGuidValueType:
+          AppendValue(hash, m_store.GetGuid(value));
+          break;
+        default:
+          break;
+        }
+      }
+    }
+  }
+  return hash.GetValue();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ACAPinc.h"
+#include "ElementStore.hpp"
+#include "JsonWriter.hpp"
+#include "QuerySnapshot.hpp"
+#include "StringTable.hpp"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief An immutable snapshot of exported elements and their property values, which the query server answers
+ * requests from on its own threads. Type, layer and property names are resolved when the snapshot is built, so
+ * answering a request never calls the Archicad API. Elements are held in guid order and their properties in key
+ * order, as in the json export. The tag identifies the snapshot's content and changes whenever any of it does.
+ */
+class ElementSnapshot : public QuerySnapshot {
+public:
+  ElementSnapshot(ElementStore&& store, const std::vector<GS::UniString>& elemTypeNames, Int32 realDecimalPlaces);
+
+  std::uint64_t GetTag() const override;
+  UInt32 GetElementCount() const;
+  std::int32_t GetRealDecimalPlaces() const override;
+
+  void FindElements(const Query& query, std::vector<std::uint32_t>& elemIndices) const override;
+  void GetPropertyMask(const Query& query, std::vector<bool>& nameMask) const override;
+  void WriteElement(std::uint32_t elemIndex, const std::vector<bool>& nameMask, JsonWriter& writer) const override;
+  void WriteTypes(JsonWriter& writer) const override;
+  void WriteLayers(JsonWriter& writer) const override;
+
+private:
+  void GetNameMask(const std::vector<std::string>& names, std::vector<bool>& nameMask) const;
+  void WriteNameCounts(const std::vector<UInt32>& elemNameIds, JsonWriter& writer) const;
+  UInt64 ComputeTag() const;
+
+  ElementStore m_store;
+  StringTable m_strings;
+  std::vector<UInt32> m_sortRanks;
+
+  // Interned names of each element's type, each layer and each property definition
+  std::vector<UInt32> m_elemTypeNameIds;
+  std::vector<UInt32> m_layerNameIds;
+  std::vector<UInt32> m_definitionNameIds;
+
+  // Elements in guid order, and each element's properties in key order, with one more offset than there are elements
+  std::vector<UInt32> m_elemOrder;
+  std::vector<UInt32> m_propertyOrder;
+  std::vector<UInt32> m_propertyOffsets;
+
+  Int32 m_realDecimalPlaces;
+  UInt64 m_tag;
+};
@@ -0,0 +1,294 @@
+#include "ElementStore.hpp"
+#include "Utf8Transcoder.hpp"
+
+namespace {
+
+// Each element takes a guid, a type id, a layer index and a property offset
+const UInt64 ElementColumnsSize = sizeof(API_Guid) + sizeof(API_ElemTypeID) + 2 * sizeof(UInt32);
+
+UInt64 GetNameSize(const GS::UniString& name)
+{
+  return name.GetLength() * sizeof(GS::UniChar);
+}
+
+}
+
+bool ElementStore::Definition::IsList() const
+{
+  return
+    collectionType == API_PropertyListCollectionType ||
+    collectionType == API_PropertyMultipleChoiceEnumerationCollectionType;
+}
+
+ElementStore::ElementStore() :
+  m_memorySize(0)
+{
+  m_propertyOffsets.push_back(0);
+}
+
+/**
+ * @brief Adds a layer name to the layer table. Layers are added once, before any elements referring to them.
+ * @param[in] layerName The name of the layer
+ * @returns The index of the layer, which elements refer to their layer by
+ */
+UInt32 ElementStore::AddLayer(const GS::UniString& layerName)
+{
+  m_layerNames.push_back(layerName);
+  m_memorySize += sizeof(GS::UniString) + GetNameSize(layerName);
+  return static_cast<UInt32>(m_layerNames.size() - 1);
+}
+
+/**
+ * @brief Adds an element and copies its property values into the store. The definitions of the properties are
+ * added to the shared definition table the first time their guid is seen.
+ * @param[in] elemGuid The guid of the element
+ * @param[in] elemTypeId The type of the element
+ * @param[in] layerIndex The index of the element's layer, as returned by AddLayer
+ * @param[in] properties The property values of the element
+ */
+void ElementStore::AddElement(const API_Guid& elemGuid, API_ElemTypeID elemTypeId, UInt32 layerIndex, const GS::Array<API_Property>& properties)
+{
+  m_elemGuids.push_back(elemGuid);
+  m_elemTypeIds.push_back(elemTypeId);
+  m_layerIndices.push_back(layerIndex);
+  m_memorySize += ElementColumnsSize;
+
+  for (const API_Property& prop : properties)
+  {
+    const API_PropertyDefinition& definition = prop.definition;
+    UInt32 definitionIndex = InternDefinition(definition.guid, definition.name, definition.collectionType, definition.valueType);
+    UInt32 firstValue = static_cast<UInt32>(m_values.size());
+
+    if (m_definitions[definitionIndex].IsList())
+    {
+      for (const API_Variant& variant : prop.value.listVariant.variants)
+        AddValue(variant, prop.definition.valueType);
+    }
+    else
+    {
+      AddValue(prop.value.singleVariant.variant, prop.definition.valueType);
+    }
+
+    UInt32 valueCount = static_cast<UInt32>(m_values.size()) - firstValue;
+    m_properties.push_back({ definitionIndex, firstValue, valueCount, prop.value.variantStatus == API_VariantStatusNormal });
+    m_memorySize += sizeof(Property);
+  }
+
+  m_propertyOffsets.push_back(static_cast<UInt32>(m_properties.size()));
+}
+
+/**
+ * @brief Copies an element and its property values from another store, such as a cache of previously fetched values
+ * @param[in] source The store to copy from
+ * @param[in] sourceElemIndex The index of the element in the source store
+ * @param[in] layerIndex The index of the element's layer in this store, as returned by AddLayer
+ */
+void ElementStore::CopyElement(const ElementStore& source, UInt32 sourceElemIndex, UInt32 layerIndex)
+{
+  m_elemGuids.push_back(source.m_elemGuids[sourceElemIndex]);
+  m_elemTypeIds.push_back(source.m_elemTypeIds[sourceElemIndex]);
+  m_layerIndices.push_back(layerIndex);
+  m_memorySize += ElementColumnsSize;
+
+  for (UInt32 i = source.GetFirstProperty(sourceElemIndex); i < source.GetPropertyEnd(sourceElemIndex); ++i)
+  {
+    const Property& prop = source.m_properties[i];
+    const Definition& definition = source.m_definitions[prop.definitionIndex];
+    UInt32 definitionIndex = InternDefinition(definition.guid, definition.name, definition.collectionType, definition.valueType);
+    UInt32 firstValue = static_cast<UInt32>(m_values.size());
+
+    for (UInt32 j = prop.firstValue; j < prop.firstValue + prop.valueCount; ++j)
+      CopyValue(source, source.m_values[j]);
+
+    m_properties.push_back({ definitionIndex, firstValue, prop.valueCount, prop.hasValue });
+    m_memorySize += sizeof(Property);
+  }
+
+  m_propertyOffsets.push_back(static_cast<UInt32>(m_properties.size()));
+}
+
+UInt32 ElementStore::GetElementCount() const
+{
+  return static_cast<UInt32>(m_elemGuids.size());
+}
+
+const API_Guid& ElementStore::GetElementGuid(UInt32 elemIndex) const
+{
+  return m_elemGuids[elemIndex];
+}
+
+API_ElemTypeID ElementStore::GetElementTypeId(UInt32 elemIndex) const
+{
+  return m_elemTypeIds[elemIndex];
+}
+
+UInt32 ElementStore::GetLayerIndex(UInt32 elemIndex) const
+{
+  return m_layerIndices[elemIndex];
+}
+
+/**
+ * @brief Obtains the index of an element's first property. The element's properties run up to GetPropertyEnd.
+ * @param[in] elemIndex The index of the element
+ * @returns The index of the first property
+ */
+UInt32 ElementStore::GetFirstProperty(UInt32 elemIndex) const
+{
+  return m_propertyOffsets[elemIndex];
+}
+
+UInt32 ElementStore::GetPropertyEnd(UInt32 elemIndex) const
+{
+  return m_propertyOffsets[elemIndex + 1];
+}
+
+UInt32 ElementStore::GetLayerCount() const
+{
+  return static_cast<UInt32>(m_layerNames.size());
+}
+
+const GS::UniString& ElementStore::GetLayerName(UInt32 layerIndex) const
+{
+  return m_layerNames[layerIndex];
+}
+
+UInt32 ElementStore::GetDefinitionCount() const
+{
+  return static_cast<UInt32>(m_definitions.size());
+}
+
+const ElementStore::Definition& ElementStore::GetDefinition(UInt32 definitionIndex) const
+{
+  return m_definitions[definitionIndex];
+}
+
+UInt32 ElementStore::GetPropertyCount() const
+{
+  return static_cast<UInt32>(m_properties.size());
+}
+
+const ElementStore::Property& ElementStore::GetProperty(UInt32 propertyIndex) const
+{
+  return m_properties[propertyIndex];
+}
+
+const ElementStore::Value& ElementStore::GetValue(UInt32 valueIndex) const
+{
+  return m_values[valueIndex];
+}
+
+/**
+ * @brief Obtains the UTF-8 text of a string value. The view is invalidated by further calls to AddElement.
+ * @param[in] value A value of string type
+ * @returns The text of the value
+ */
+std::string_view ElementStore::GetString(const Value& value) const
+{
+  return std::string_view(m_stringBytes.data() + value.stringOffset, value.stringLength);
+}
+
+const API_Guid& ElementStore::GetGuid(const Value& value) const
+{
+  return m_guidValues[value.guidIndex];
+}
+
+/**
+ * @brief Obtains the memory held by the store's columns and buffers, which is counted as they grow so that it can
+ * be checked after every batch of elements
+ * @returns The size in bytes
+ */
+UInt64 ElementStore::GetMemorySize() const
+{
+  return m_memorySize;
+}
+
+/**
+ * @brief Estimates the memory needed to store elements before their values are known, assuming a single value
+ * per property
+ * @param[in] elementCount The number of elements
+ * @param[in] propertyCount The total number of properties of the elements
+ * @param[in] stringBytes The total size of the UTF-8 string values
+ * @returns The estimated size in bytes
+ */
+UInt64 ElementStore::EstimateMemorySize(UInt64 elementCount, UInt64 propertyCount, UInt64 stringBytes)
+{
+  return
+    elementCount * ElementColumnsSize +
+    propertyCount * (sizeof(Property) + sizeof(Value)) +
+    stringBytes;
+}
+
+UInt32 ElementStore::InternDefinition(const API_Guid& guid, const GS::UniString& name, API_PropertyCollectionType collectionType, API_VariantType valueType)
+{
+  const GS::Guid& definitionGuid = APIGuid2GSGuid(guid);
+  if (m_definitionIndices.ContainsKey(definitionGuid))
+    return m_definitionIndices.Get(definitionGuid);
+
+  UInt32 definitionIndex = static_cast<UInt32>(m_definitions.size());
+  m_definitions.push_back({ guid, name, collectionType, valueType });
+  m_definitionIndices.Add(definitionGuid, definitionIndex);
+  m_memorySize += sizeof(Definition) + GetNameSize(name);
+  return definitionIndex;
+}
+
+void ElementStore::AddValue(const API_Variant& variant, API_VariantType valueType)
+{
+  Value value;
+  value.type = valueType;
+  value.stringLength = 0;
+
+  switch (valueType)
+  {
+  case API_PropertyIntegerValueType:
+    value.intValue = variant.intValue;
+    break;
+  case API_PropertyRealValueType:
+    value.realValue = variant.doubleValue;
+    break;
+  case API_PropertyBooleanValueType:
+    value.boolValue = variant.boolValue;
+    break;
+  case API_PropertyStringValueType:
+  {
+    // Strings are converted straight into the string buffer
+    size_t offset = m_stringBytes.size();
+    Utf8Transcoder::Append(m_stringBytes, variant.uniStringValue);
+    value.stringOffset = offset;
+    value.stringLength = static_cast<UInt32>(m_stringBytes.size() - offset);
+    m_memorySize += value.stringLength;
+    break;
+  }
+  case API_PropertyGuidValueType:
+    value.guidIndex = static_cast<UInt32>(m_guidValues.size());
+    m_guidValues.push_back(variant.guidValue);
+    m_memorySize += sizeof(API_Guid);
+    break;
+  default:
+    value.intValue = 0;
+    break;
+  }
+
+  m_values.push_back(value);
+  m_memorySize += sizeof(Value);
+}
+
+void ElementStore::CopyValue(const ElementStore& source, const Value& value)
+{
+  Value copy = value;
+  if (value.type == API_PropertyStringValueType)
+  {
+    std::string_view str = source.GetString(value);
+    copy.stringOffset = m_stringBytes.size();
+    m_stringBytes.append(str);
+    m_memorySize += str.size();
+  }
+  else if (value.type == API_PropertyGuidValueType)
+  {
+    copy.guidIndex = static_cast<UInt32>(m_guidValues.size());
+    m_guidValues.push_back(source.GetGuid(value));
+    m_memorySize += sizeof(API_Guid);
+  }
+
+  m_values.push_back(copy);
+  m_memorySize += sizeof(Value);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ACAPinc.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Compact, column-oriented store of exported elements and their property values. Elements are held as
+ * parallel columns of guids, type ids, layer indices and property offsets. Properties refer to a single shared
+ * table of definitions, and their values are held in one contiguous buffer of tagged values, with string
+ * values stored as UTF-8 bytes in a separate buffer.
+ */
+class ElementStore {
+public:
+  /**
+   * @brief A property definition shared by every property with the same guid
+   */
+  struct Definition
+  {
+    API_Guid guid;
+    GS::UniString name;
+    API_PropertyCollectionType collectionType;
+    API_VariantType valueType;
+
+    bool IsList() const;
+  };
+
+  /**
+   * @brief A property of an element, referring to its definition and to a run of values in the value buffer.
+   * Single properties always have one value, list properties have one value per item.
+   */
+  struct Property
+  {
+    UInt32 definitionIndex;
+    UInt32 firstValue;
+    UInt32 valueCount;
+    bool hasValue;
+  };
+
+  /**
+   * @brief A single value, tagged with its type. Strings refer to a span of the string buffer and guids to an
+   * entry of the guid buffer. The string buffer can pass 4 GiB, so string offsets are 64-bit, with the length held
+   * beside the type where it takes no extra space.
+   */
+  struct Value
+  {
+    API_VariantType type;
+    UInt32 stringLength;
+    union
+    {
+      Int32 intValue;
+      double realValue;
+      bool boolValue;
+      UInt64 stringOffset;
+      UInt32 guidIndex;
+    };
+  };
+
+  ElementStore();
+
+  UInt32 AddLayer(const GS::UniString& layerName);
+  void AddElement(const API_Guid& elemGuid, API_ElemTypeID elemTypeId, UInt32 layerIndex, const GS::Array<API_Property>& properties);
+  void CopyElement(const ElementStore& source, UInt32 sourceElemIndex, UInt32 layerIndex);
+
+  UInt32 GetElementCount() const;
+  const API_Guid& GetElementGuid(UInt32 elemIndex) const;
+  API_ElemTypeID GetElementTypeId(UInt32 elemIndex) const;
+  UInt32 GetLayerIndex(UInt32 elemIndex) const;
+  UInt32 GetFirstProperty(UInt32 elemIndex) const;
+  UInt32 GetPropertyEnd(UInt32 elemIndex) const;
+
+  UInt32 GetLayerCount() const;
+  const GS::UniString& GetLayerName(UInt32 layerIndex) const;
+
+  UInt32 GetDefinitionCount() const;
+  const Definition& GetDefinition(UInt32 definitionIndex) const;
+
+  UInt32 GetPropertyCount() const;
+  const Property& GetProperty(UInt32 propertyIndex) const;
+  const Value& GetValue(UInt32 valueIndex) const;
+  std::string_view GetString(const Value& value) const;
+  const API_Guid& GetGuid(const Value& value) const;
+
+  UInt64 GetMemorySize() const;
+  static UInt64 EstimateMemorySize(UInt64 elementCount, UInt64 propertyCount, UInt64 stringBytes);
+
+private:
+  UInt32 InternDefinition(const API_Guid& guid, const GS::UniString& name, API_PropertyCollectionType collectionType, API_VariantType valueType);
+  void AddValue(const API_Variant& variant, API_VariantType valueType);
+  void CopyValue(const ElementStore& source, const Value& value);
+
+  // Element columns, with one more property offset than there are elements
+  std::vector<API_Guid> m_elemGuids;
+  std::vector<API_ElemTypeID> m_elemTypeIds;
+  std::vector<UInt32> m_layerIndices;
+  std::vector<UInt32> m_propertyOffsets;
+
+  std::vector<GS::UniString> m_layerNames;
+  std::vector<Definition> m_definitions;
+  GS::HashTable<GS::Guid, UInt32> m_definitionIndices;
+
+  std::vector<Property> m_properties;
+  std::vector<Value> m_values;
+  std::vector<API_Guid> m_guidValues;
+  std::string m_stringBytes;
+  UInt64 m_memorySize;
+};
@@ -0,0 +1,322 @@
+#include "ExportPlan.hpp"
+#include "ContentHash.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// Plans cached in the session, beyond which the least recently used plan is evicted before adding another
+const size_t MaxSessionPlans = 16;
+
+const char* JsonContentType = "application/json";
+const char* ArrowContentType = "application/vnd.apache.arrow.file";
+
+/**
+ * @brief A plan cached in the session, with the order in which cached plans were last used
+ */
+struct SessionPlan
+{
+  std::shared_ptr<ExportPlan> plan;
+  UInt64 lastUse;
+};
+
+template <typename T>
+void AppendValue(ContentHash& hash, const T& value)
+{
+  hash.Append(&value, sizeof(T));
+}
+
+void AppendString(ContentHash& hash, const GS::UniString& str)
+{
+  // Strings are prefixed by their length, so that consecutive strings cannot run into each other
+  AppendValue(hash, str.GetLength());
+  hash.Append(str.ToUStr().Get(), str.GetLength() * sizeof(GS::UniChar::Layout));
+}
+
+void AppendStrings(ContentHash& hash, const GS::Array<GS::UniString>& strs)
+{
+  AppendValue(hash, strs.GetSize());
+  for (const GS::UniString& str : strs)
+    AppendString(hash, str);
+}
+
+std::string ToUtf8(const GS::UniString& str)
+{
+  return str.ToCStr(0, MaxUSize, CC_UTF8).Get();
+}
+
+json ToUtf8Array(const GS::Array<GS::UniString>& strs)
+{
+  json array = json::array();
+  for (const GS::UniString& str : strs)
+    array.push_back(ToUtf8(str));
+  return array;
+}
+
+const char* GetFilterName(API_PropertyDefinitionFilter filter)
+{
+  switch (filter)
+  {
+  case API_PropertyDefinitionFilter_UserDefined:        return "userDefined";
+  case API_PropertyDefinitionFilter_FundamentalBuiltIn: return "fundamentalBuiltIn";
+  case API_PropertyDefinitionFilter_UserLevelBuiltIn:   return "userLevelBuiltIn";
+  case API_PropertyDefinitionFilter_All:                return "all";
+  default:                                              return "unknown";
+  }
+}
+
+}
+
+/**
+ * @brief Resolves a plan from export settings
+ * @param[in] settingsData The settings to resolve the plan from
+ */
+ExportPlan::ExportPlan(const JsonExportSettingsData& settingsData) :
+  m_settings(settingsData),
+  m_fingerprint(GetFingerprint(settingsData)),
+  m_appliedFingerprint(GetAppliedFingerprint(settingsData)),
+  m_allowList(settingsData.propertyAllowList),
+  m_filePath(settingsData.filePath.ToCStr().Get()),
+  m_estimates(API_LastElemType + 1, TypeEstimate { 0, 0 }),
+  m_exportCount(0)
+{
+  ResolveElementTypes(settingsData.elemTypeNames, m_elemTypes, m_elemTypeNames);
+}
+
+/**
+ * @brief Obtains the plan for the given settings, resolving it only if no plan has been cached in the session for
+ * settings with the same fingerprint. A cached plan whose applied settings differ is replaced by a copy holding the
+ * new ones, so that exports holding the cached plan keep the settings they started with.
+ * @param[in] settingsData The settings of the export
+ * @param[out] isReused True if the plan was taken from the cache
+ * @returns The plan, which is shared with the cache and stays valid for as long as it is held
+ */
+std::shared_ptr<ExportPlan> ExportPlan::GetSessionPlan(const JsonExportSettingsData& settingsData, bool& isReused)
+{
+  static std::unordered_map<UInt64, SessionPlan> sessionPlans;
+  static UInt64 useCount = 0;
+
+  UInt64 fingerprint = GetFingerprint(settingsData);
+  auto it = sessionPlans.find(fingerprint);
+  isReused = it != sessionPlans.end();
+  if (isReused)
+  {
+    std::shared_ptr<ExportPlan>& plan = it->second.plan;
+    if (plan->m_appliedFingerprint != GetAppliedFingerprint(settingsData))
+    {
+      plan = std::make_shared<ExportPlan>(*plan);
+      plan->m_settings = settingsData;
+      plan->m_filePath = settingsData.filePath.ToCStr().Get();
+      plan->m_appliedFingerprint = GetAppliedFingerprint(settingsData);
+    }
+    it->second.lastUse = ++useCount;
+    return plan;
+  }
+
+  // Evicting a plan only drops the cache's share of it, so exports still holding it are unaffected
+  if (sessionPlans.size() >= MaxSessionPlans)
+  {
+    sessionPlans.erase(std::min_element(sessionPlans.begin(), sessionPlans.end(), [](const auto& a, const auto& b)
+    {
+      return a.second.lastUse < b.second.lastUse;
+    }));
+  }
+  std::shared_ptr<ExportPlan> plan = std::make_shared<ExportPlan>(settingsData);
+  sessionPlans[fingerprint] = { plan, ++useCount };
+  return plan;
+}
+
+/**
+ * @brief Computes a fingerprint of the settings a plan is resolved from, which decide the elements collected, their
+ * property definitions and how they are serialized. Settings applied as they are, such as the file path, url, batch
+ * size and memory budget, are left out, so that changing them reuses the plan.
+ * @param[in] settingsData The settings to fingerprint
+ * @returns The 64-bit fingerprint
+ */
+UInt64 ExportPlan::GetFingerprint(const JsonExportSettingsData& settingsData)
+{
+  ContentHash hash;
+  AppendValue(hash, GetCollectionFingerprint(settingsData));
+  AppendValue(hash, settingsData.exportFormat);
+  AppendValue(hash, settingsData.realDecimalPlaces);
+  return hash.GetValue();
+}
+
+/**
+ * @brief Computes a fingerprint of the settings that decide which elements are collected and which of their
+ * property definitions are requested, leaving out those that only affect how values are fetched and exported
+ * @param[in] settingsData The settings to fingerprint
+ * @returns The 64-bit fingerprint
+ */
+UInt64 ExportPlan::GetCollectionFingerprint(const JsonExportSettingsData& settingsData)
+{
+  ContentHash hash;
+  AppendValue(hash, settingsData.propertyDefinitionFilters.GetSize());
+  for (API_PropertyDefinitionFilter filter : settingsData.propertyDefinitionFilters)
+    AppendValue(hash, filter);
+  AppendStrings(hash, settingsData.propertyAllowList);
+  AppendStrings(hash, settingsData.elemTypeNames);
+  AppendValue(hash, settingsData.selectedOnly);
+  AppendValue(hash, settingsData.filterStoreys);
+  AppendValue(hash, settingsData.minStorey);
+  AppendValue(hash, settingsData.maxStorey);
+  AppendValue(hash, settingsData.visibleLayersOnly);
+  AppendStrings(hash, settingsData.classifications);
+  return hash.GetValue();
+}
+
+UInt64 ExportPlan::GetAppliedFingerprint(const JsonExportSettingsData& settingsData)
+{
+  ContentHash hash;
+  AppendString(hash, settingsData.filePath);
+  AppendString(hash, settingsData.baseUrl);
+  AppendValue(hash, settingsData.exportToFile);
+  AppendValue(hash, settingsData.exportToUrl);
+  AppendValue(hash, settingsData.propertyBatchSize);
+  AppendValue(hash, settingsData.recordTrace);
+  AppendValue(hash, settingsData.memoryBudgetMegabytes);
+  AppendValue(hash, settingsData.reuseUnchangedValues);
+  AppendValue(hash, settingsData.serveLocally);
+  AppendValue(hash, settingsData.serverPort);
+  return hash.GetValue();
+}
+
+const JsonExportSettingsData& ExportPlan::GetSettings() const
+{
+  return m_settings;
+}
+
+const GS::Array<API_ElemTypeID>& ExportPlan::GetElemTypes() const
+{
+  return m_elemTypes;
+}
+
+const PropertyAllowList& ExportPlan::GetAllowList() const
+{
+  return m_allowList;
+}
+
+bool ExportPlan::IsArrowFormat() const
+{
+  return m_settings.exportFormat == ExportFormat::Arrow;
+}
+
+const char* ExportPlan::GetContentType() const
+{
+  return IsArrowFormat() ? ArrowContentType : JsonContentType;
+}
+
+/**
+ * @brief Obtains the UTF-8 path of the export file
+ */
+const std::string& ExportPlan::GetFilePath() const
+{
+  return m_filePath;
+}
+
+UInt64 ExportPlan::GetMemoryBudgetBytes() const
+{
+  return static_cast<UInt64>(m_settings.memoryBudgetMegabytes) * 1024 * 1024;
+}
+
+/**
+ * @brief Starts recording the element and property counts of an export, replacing those of the previous export
+ */
+void ExportPlan::BeginEstimates()
+{
+  std::fill(m_estimates.begin(), m_estimates.end(), TypeEstimate { 0, 0 });
+  ++m_exportCount;
+}
+
+/**
+ * @brief Adds a collected element to the counts of the current export
+ * @param[in] elemTypeId The type of the element
+ * @param[in] propertyCount The number of properties requested for the element
+ */
+void ExportPlan::AddToEstimates(API_ElemTypeID elemTypeId, UInt64 propertyCount)
+{
+  size_t typeIndex = static_cast<size_t>(elemTypeId);
+  if (typeIndex >= m_estimates.size())
+    return;
+
+  ++m_estimates[typeIndex].elements;
+  m_estimates[typeIndex].properties += propertyCount;
+}
+
+/**
+ * @brief Describes the plan, listing what it resolved from the settings along with the element and property
+ * counts estimated for its next export
+ * @returns Json describing the plan
+ */
+json ExportPlan::Explain() const
+{
+  json planJson;
+
+  char fingerprint[17];
+  std::snprintf(fingerprint, sizeof(fingerprint), "%016llx", static_cast<unsigned long long>(m_fingerprint));
+  planJson["fingerprint"] = fingerprint;
+  planJson["exports"] = m_exportCount;
+
+  planJson["elements"]["source"] = m_settings.selectedOnly ? "selection" : "project";
+  planJson["elements"]["types"] = ToUtf8Array(m_elemTypeNames);
+  planJson["elements"]["filters"]["storeys"] = m_settings.filterStoreys ? json::array({ m_settings.minStorey, m_settings.maxStorey }) : json();
+  planJson["elements"]["filters"]["visibleLayersOnly"] = m_settings.visibleLayersOnly;
+  planJson["elements"]["filters"]["classifications"] = ToUtf8Array(m_settings.classifications);
+
+  json propertyFilters = json::array();
+  for (API_PropertyDefinitionFilter filter : m_settings.propertyDefinitionFilters)
+    propertyFilters.push_back(GetFilterName(filter));
+  planJson["properties"]["definitionFilters"] = propertyFilters;
+  planJson["properties"]["allowList"] = ToUtf8Array(m_settings.propertyAllowList);
+  planJson["properties"]["batchSize"] = m_settings.propertyBatchSize;
+
+  planJson["output"]["format"] = IsArrowFormat() ? "arrow" : "json";
+  planJson["output"]["grouping"] = json::array({ "layer", "elementType", "guid" });
+  planJson["output"]["file"] = m_settings.exportToFile ? json(m_filePath) : json();
+  planJson["output"]["url"] = m_settings.exportToUrl ? json(ToUtf8(m_settings.baseUrl)) : json();
+  planJson["output"]["serverPort"] = m_settings.serveLocally ? json(m_settings.serverPort) : json();
+  planJson["output"]["contentType"] = GetContentType();
+  planJson["output"]["memoryBudgetBytes"] = GetMemoryBudgetBytes();
+
+  // Estimates are the counts of the latest export, which are only known once an export has collected its elements
+  UInt64 totalElements = 0;
+  UInt64 totalProperties = 0;
+  json byType = json::object();
+  for (size_t i = 0; i < m_estimates.size(); ++i)
+  {
+    const TypeEstimate& estimate = m_estimates[i];
+    if (estimate.elements == 0)
+      continue;
+
+    GS::UniString elemTypeName;
+    ACAPI_Element_GetElemTypeName(static_cast<API_ElemTypeID>(i), elemTypeName);
+    byType[ToUtf8(elemTypeName)] = { { "elements", estimate.elements }, { "properties", estimate.properties } };
+    totalElements += estimate.elements;
+    totalProperties += estimate.properties;
+  }
+  planJson["estimates"]["elements"] = m_exportCount > 0 ? json(totalElements) : json();
+  planJson["estimates"]["properties"] = m_exportCount > 0 ? json(totalProperties) : json();
+  planJson["estimates"]["byType"] = byType;
+
+  return planJson;
+}
+
+void ExportPlan::ResolveElementTypes(const GS::Array<GS::UniString>& elemTypeNames, GS::Array<API_ElemTypeID>& elemTypes, GS::Array<GS::UniString>& resolvedNames)
+{
+  // Match names against every element type, whether or not the project has elements of the type yet, so that the
+  // plan stays valid as elements are added
+  for (int i = API_FirstElemType; i <= API_LastElemType; ++i)
+  {
+    API_ElemTypeID elemTypeId = API_ElemTypeID(i);
+    GS::UniString elemTypeName;
+    if (ACAPI_Element_GetElemTypeName(elemTypeId, elemTypeName) != NoError)
+      continue;
+
+    if (elemTypeNames.Contains(elemTypeName))
+    {
+      elemTypes.Push(elemTypeId);
+      resolvedNames.Push(elemTypeName);
+    }
+  }
+}
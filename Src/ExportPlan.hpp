@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ACAPinc.h"
+#include "ExportReport.hpp"
+#include "JsonExportSettingsData.hpp"
+#include "PropertyAllowList.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Everything about an export that is derived from its settings alone: the element types to collect, the
+ * element and property filters, the output format and the file and url to export to. Plans are cached for the rest
+ * of the session by a fingerprint of the collection and serialization settings they were resolved from, so repeated
+ * exports with the same settings skip resolving them again. Settings that are applied as they are, such as the file
+ * path, do not take part in the fingerprint. Each plan also keeps the element and property counts of its latest
+ * export, which estimate those of the next one.
+ */
+class ExportPlan {
+public:
+  explicit ExportPlan(const JsonExportSettingsData& settingsData);
+
+  static std::shared_ptr<ExportPlan> GetSessionPlan(const JsonExportSettingsData& settingsData, bool& isReused);
+  static UInt64 GetFingerprint(const JsonExportSettingsData& settingsData);
+  static UInt64 GetCollectionFingerprint(const JsonExportSettingsData& settingsData);
+
+  const JsonExportSettingsData& GetSettings() const;
+  const GS::Array<API_ElemTypeID>& GetElemTypes() const;
+  const PropertyAllowList& GetAllowList() const;
+  bool IsArrowFormat() const;
+  const char* GetContentType() const;
+  const std::string& GetFilePath() const;
+  UInt64 GetMemoryBudgetBytes() const;
+
+  void BeginEstimates();
+  void AddToEstimates(API_ElemTypeID elemTypeId, UInt64 propertyCount);
+  json Explain() const;
+
+private:
+  /**
+   * @brief The number of elements of a type collected by the latest export, and their total number of properties
+   */
+  struct TypeEstimate
+  {
+    UInt64 elements;
+    UInt64 properties;
+  };
+
+  static UInt64 GetAppliedFingerprint(const JsonExportSettingsData& settingsData);
+  static void ResolveElementTypes(const GS::Array<GS::UniString>& elemTypeNames, GS::Array<API_ElemTypeID>& elemTypes, GS::Array<GS::UniString>& resolvedNames);
+
+  JsonExportSettingsData m_settings;
+  UInt64 m_fingerprint;
+  UInt64 m_appliedFingerprint;
+  GS::Array<API_ElemTypeID> m_elemTypes;
+  GS::Array<GS::UniString> m_elemTypeNames;
+  PropertyAllowList m_allowList;
+  std::string m_filePath;
+  std::vector<TypeEstimate> m_estimates;
+  UInt32 m_exportCount;
+};
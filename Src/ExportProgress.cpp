@@ -0,0 +1,143 @@
+#include "ExportProgress.hpp"
+
+/**
+ * @brief Constructs a reporter for the given listener
+ * @param[in] listener The listener to send progress to. May be null, in which case progress is not tracked.
+ */
+ExportProgressReporter::ExportProgressReporter(ExportProgressListener* listener) :
+  m_listener(listener),
+  m_progress({ ExportPhase::TypeResolution, 0, 0, 0, 0, 0.0, -1.0 })
+{
+}
+
+/**
+ * @brief Starts a new phase, resetting the items done and the throughput estimate. Always reported immediately.
+ * @param[in] phase The phase being started
+ * @param[in] itemsTotal The number of items the phase will process
+ */
+void ExportProgressReporter::BeginPhase(ExportPhase phase, UInt64 itemsTotal)
+{
+  if (m_listener == nullptr)
+    return;
+
+  m_progress.phase = phase;
+  m_progress.itemsDone = 0;
+  m_progress.itemsTotal = itemsTotal;
+  m_samples.clear();
+  Report(std::chrono::steady_clock::now());
+}
+
+/**
+ * @brief Marks items of the current phase as done. Cheap enough to call for every item, as the listener is
+ * only notified once per ReportInterval.
+ * @param[in] items The number of items done
+ */
+void ExportProgressReporter::Advance(UInt64 items)
+{
+  if (m_listener == nullptr)
+    return;
+
+  m_progress.itemsDone += items;
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now - m_lastReportTime >= ReportInterval)
+    Report(now);
+}
+
+void ExportProgressReporter::AddBytesWritten(UInt64 bytes)
+{
+  m_progress.bytesWritten += bytes;
+  Flush();
+}
+
+void ExportProgressReporter::AddBytesUploaded(UInt64 bytes)
+{
+  m_progress.bytesUploaded += bytes;
+  Flush();
+}
+
+/**
+ * @brief Reports the current progress to the listener regardless of when it was last notified
+ */
+void ExportProgressReporter::Flush()
+{
+  if (m_listener != nullptr)
+    Report(std::chrono::steady_clock::now());
+}
+
+/**
+ * @brief Constructs a relay for the given listener
+ * @param[in] listener The listener to forward progress to. May be null, in which case progress is dropped.
+ */
+ExportProgressRelay::ExportProgressRelay(ExportProgressListener* listener) :
+  m_listener(listener),
+  m_progress({ ExportPhase::TypeResolution, 0, 0, 0, 0, 0.0, -1.0 }),
+  m_isChanged(false)
+{
+}
+
+/**
+ * @brief Holds on to progress reported from any thread until it is forwarded
+ */
+void ExportProgressRelay::ProgressChanged(const ExportProgress& progress)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_progress = progress;
+  m_isChanged = true;
+}
+
+/**
+ * @brief Forwards the latest progress to the listener, if it has changed since it was last forwarded
+ */
+void ExportProgressRelay::Forward()
+{
+  ExportProgress progress;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_isChanged || m_listener == nullptr)
+      return;
+
+    progress = m_progress;
+    m_isChanged = false;
+  }
+  m_listener->ProgressChanged(progress);
+}
+
+const char* ExportProgressReporter::GetPhaseDescription(ExportPhase phase)
+{
+  switch (phase)
+  {
+  case ExportPhase::TypeResolution:      return "Resolving element types";
+  case ExportPhase::GuidCollection:      return "Collecting elements";
+  case ExportPhase::HeaderFetch:         return "Reading element headers";
+  case ExportPhase::ClassificationFetch: return "Reading classifications";
+  case ExportPhase::DefinitionFetch:     return "Reading property definitions";
+  case ExportPhase::ValueFetch:          return "Reading property values";
+  case ExportPhase::Parse:               return "Preparing data";
+  case ExportPhase::Serialize:           return "Serializing data";
+  case ExportPhase::Write:               return "Writing to file";
+  case ExportPhase::Upload:              return "Uploading to url";
+  default:                               return "Exporting";
+  }
+}
+
+void ExportProgressReporter::Report(std::chrono::steady_clock::time_point now)
+{
+  // Keep samples covering the throughput window, measuring the rate from the oldest one
+  m_samples.push_back({ now, m_progress.itemsDone });
+  while (m_samples.size() > 2 && now - m_samples[1].time >= ThroughputWindow)
+    m_samples.pop_front();
+
+  const Sample& oldest = m_samples.front();
+  std::chrono::duration<double> elapsed = now - oldest.time;
+  UInt64 itemsDone = m_progress.itemsDone - oldest.itemsDone;
+
+  m_progress.itemsPerSecond = elapsed.count() > 0.0 ? itemsDone / elapsed.count() : 0.0;
+  if (m_progress.itemsPerSecond > 0.0 && m_progress.itemsTotal >= m_progress.itemsDone)
+    m_progress.etaSeconds = (m_progress.itemsTotal - m_progress.itemsDone) / m_progress.itemsPerSecond;
+  else
+    m_progress.etaSeconds = -1.0;
+
+  m_lastReportTime = now;
+  m_listener->ProgressChanged(m_progress);
+}
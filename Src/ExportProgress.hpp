@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ACAPinc.h"
+#include "ExportReport.hpp"
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+/**
+ * @brief A snapshot of an export's progress through its current phase
+ */
+struct ExportProgress
+{
+  ExportPhase phase;
+  UInt64 itemsDone;
+  UInt64 itemsTotal;
+  UInt64 bytesWritten;
+  UInt64 bytesUploaded;
+  double itemsPerSecond;
+  double etaSeconds; // negative while the remaining time is unknown
+};
+
+/**
+ * @brief Receives progress updates from a running export
+ */
+class ExportProgressListener {
+public:
+  virtual ~ExportProgressListener() = default;
+
+  virtual void ProgressChanged(const ExportProgress& progress) = 0;
+};
+
+/**
+ * @brief Hands progress reported on a worker thread on to a listener on the API thread. The latest progress is held
+ * until Forward is called, so the listener is only ever notified from the thread calling Forward.
+ */
+class ExportProgressRelay : public ExportProgressListener {
+public:
+  explicit ExportProgressRelay(ExportProgressListener* listener);
+
+  void ProgressChanged(const ExportProgress& progress) override;
+  void Forward();
+
+private:
+  ExportProgressListener* m_listener;
+  std::mutex m_mutex;
+  ExportProgress m_progress;
+  bool m_isChanged;
+};
+
+/**
+ * @brief Tracks an export's progress and forwards it to a listener, no more often than every ReportInterval.
+ * The remaining time is estimated from the throughput over the last ThroughputWindow of the current phase.
+ */
+class ExportProgressReporter {
+public:
+  static constexpr std::chrono::milliseconds ReportInterval{ 100 };
+  static constexpr std::chrono::milliseconds ThroughputWindow{ 5000 };
+
+  explicit ExportProgressReporter(ExportProgressListener* listener);
+
+  void BeginPhase(ExportPhase phase, UInt64 itemsTotal);
+  void Advance(UInt64 items = 1);
+  void AddBytesWritten(UInt64 bytes);
+  void AddBytesUploaded(UInt64 bytes);
+  void Flush();
+
+  static const char* GetPhaseDescription(ExportPhase phase);
+
+private:
+  struct Sample
+  {
+    std::chrono::steady_clock::time_point time;
+    UInt64 itemsDone;
+  };
+
+  void Report(std::chrono::steady_clock::time_point now);
+
+  ExportProgressListener* m_listener;
+  ExportProgress m_progress;
+  std::deque<Sample> m_samples;
+  std::chrono::steady_clock::time_point m_lastReportTime;
+};
@@ -0,0 +1,213 @@
+#include "ExportReport.hpp"
+#include "ContentHash.hpp"
+
+#include <cstdio>
+
+ExportReport::ScopedPhase::ScopedPhase(ExportReport& report, ExportPhase phase) :
+  m_report(report),
+  m_phase(phase),
+  m_start(std::chrono::steady_clock::now()),
+  m_isStopped(false),
+  m_span(GetPhaseName(phase), "phase")
+{
+}
+
+ExportReport::ScopedPhase::~ScopedPhase()
+{
+  Stop();
+}
+
+/**
+ * @brief Ends the phase before the scope exits. Further calls have no effect.
+ */
+void ExportReport::ScopedPhase::Stop()
+{
+  if (m_isStopped)
+    return;
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_start;
+  m_report.AddPhaseDuration(m_phase, elapsed.count());
+  m_span.Stop();
+  m_isStopped = true;
+}
+
+ExportReport::ExportReport() :
+  m_start(std::chrono::steady_clock::now()),
+  m_isFinished(false)
+{
+  m_phaseMilliseconds.fill(0.0);
+  m_counts.fill(0);
+}
+
+/**
+ * @brief Stops the total time once the export's work is done, so that it leaves out time spent reading the
+ * results shown afterwards. Further calls have no effect.
+ */
+void ExportReport::Finish()
+{
+  if (m_isFinished)
+    return;
+
+  m_end = std::chrono::steady_clock::now();
+  m_isFinished = true;
+}
+
+void ExportReport::AddPhaseDuration(ExportPhase phase, double milliseconds)
+{
+  m_phaseMilliseconds[static_cast<size_t>(phase)] += milliseconds;
+}
+
+void ExportReport::AddCount(ExportCounter counter, UInt64 count)
+{
+  m_counts[static_cast<size_t>(counter)] += count;
+}
+
+/**
+ * @brief Adds every counter of another report, such as one of the work done ahead of an export that the export takes
+ * over. Phase durations are not added, as that work ran before the export started.
+ * @param[in] other The report to add the counters of
+ */
+void ExportReport::AddCounts(const ExportReport& other)
+{
+  for (size_t i = 0; i < m_counts.size(); ++i)
+    m_counts[i] += other.m_counts[i];
+}
+
+double ExportReport::GetPhaseDuration(ExportPhase phase) const
+{
+  return m_phaseMilliseconds[static_cast<size_t>(phase)];
+}
+
+/**
+ * @brief Obtains the wall time from when the report was created at the start of the export until it was finished,
+ * or until now if it is not finished yet
+ * @returns The elapsed time in milliseconds
+ */
+double ExportReport::GetTotalDuration() const
+{
+  std::chrono::steady_clock::time_point end = m_isFinished ? m_end : std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - m_start).count();
+}
+
+UInt64 ExportReport::GetCount(ExportCounter counter) const
+{
+  return m_counts[static_cast<size_t>(counter)];
+}
+
+/**
+ * @brief Adds serialized output to the hash of the export. Data is hashed in the order it is supplied, so an export
+ * written in chunks has the same hash as one written in one go.
+ * @param[in] data The next part of the serialized output
+ */
+void ExportReport::HashOutput(std::string_view data)
+{
+  m_outputHash.Append(data.data(), data.size());
+}
+
+/**
+ * @brief Obtains the 64-bit xxHash64 hash of the serialized output, which is identical for exports of identical data
+ */
+UInt64 ExportReport::GetOutputHash() const
+{
+  return m_outputHash.GetValue();
+}
+
+MemoryTracker& ExportReport::GetMemory()
+{
+  return m_memory;
+}
+
+const MemoryTracker& ExportReport::GetMemory() const
+{
+  return m_memory;
+}
+
+/**
+ * @brief Obtains a human readable summary of the total time, the slowest phase and the peak memory used
+ */
+GS::UniString ExportReport::GetSummary() const
+{
+  size_t slowestPhase = 0;
+  for (size_t i = 0; i < m_phaseMilliseconds.size(); ++i)
+  {
+    if (m_phaseMilliseconds[i] > m_phaseMilliseconds[slowestPhase])
+      slowestPhase = i;
+  }
+
+  return GS::UniString::Printf("%llu elements exported in %.1f ms (slowest phase: %s, %.1f ms, peak memory: %.1f MB)",
+    static_cast<unsigned long long>(GetCount(ExportCounter::Elements)), GetTotalDuration(),
+    GetPhaseName(static_cast<ExportPhase>(slowestPhase)), m_phaseMilliseconds[slowestPhase],
+    m_memory.GetPeakBytes() / (1024.0 * 1024.0));
+}
+
+/**
+ * @brief Builds the machine-readable form of the report
+ * @returns Json containing the milliseconds spent per phase and in total, the value of each counter, the hash of the output and
+ * the peak memory used
+ */
+json ExportReport::ToJson() const
+{
+  json reportJson;
+  for (size_t i = 0; i < m_phaseMilliseconds.size(); ++i)
+    reportJson["phases"][GetPhaseName(static_cast<ExportPhase>(i))] = m_phaseMilliseconds[i];
+  reportJson["totalMilliseconds"] = GetTotalDuration();
+
+  for (size_t i = 0; i < m_counts.size(); ++i)
+    reportJson["counters"][GetCounterName(static_cast<ExportCounter>(i))] = m_counts[i];
+
+  char outputHash[17];
+  std::snprintf(outputHash, sizeof(outputHash), "%016llx", static_cast<unsigned long long>(m_outputHash.GetValue()));
+  reportJson["outputHash"] = outputHash;
+
+  reportJson["memory"]["peakBytes"] = m_memory.GetPeakBytes();
+  for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); ++i)
+  {
+    MemoryCategory category = static_cast<MemoryCategory>(i);
+    reportJson["memory"]["peakBytesByCategory"][MemoryTracker::GetCategoryName(category)] = m_memory.GetPeakBytes(category);
+  }
+
+  return reportJson;
+}
+
+const char* ExportReport::GetPhaseName(ExportPhase phase)
+{
+  switch (phase)
+  {
+  case ExportPhase::TypeResolution:      return "typeResolution";
+  case ExportPhase::GuidCollection:      return "guidCollection";
+  case ExportPhase::HeaderFetch:         return "headerFetch";
+  case ExportPhase::ClassificationFetch: return "classificationFetch";
+  case ExportPhase::DefinitionFetch:     return "definitionFetch";
+  case ExportPhase::ValueFetch:          return "valueFetch";
+  case ExportPhase::Parse:               return "parse";
+  case ExportPhase::Serialize:           return "serialize";
+  case ExportPhase::Write:               return "write";
+  case ExportPhase::Upload:              return "upload";
+  default:                               return "unknown";
+  }
+}
+
+const char* ExportReport::GetCounterName(ExportCounter counter)
+{
+  switch (counter)
+  {
+  case ExportCounter::Elements:                  return "elements";
+  case ExportCounter::Properties:                return "properties";
+  case ExportCounter::BytesSerialized:           return "bytesSerialized";
+  case ExportCounter::BytesWritten:              return "bytesWritten";
+  case ExportCounter::BytesUploaded:             return "bytesUploaded";
+  case ExportCounter::CacheHits:                 return "cacheHits";
+  case ExportCounter::CacheMisses:               return "cacheMisses";
+  case ExportCounter::Failures:                  return "failures";
+  case ExportCounter::HeaderFetches:             return "headerFetches";
+  case ExportCounter::PropertyCacheHits:         return "propertyCacheHits";
+  case ExportCounter::PropertyCacheMisses:       return "propertyCacheMisses";
+  case ExportCounter::FailingDefinitions:        return "failingDefinitions";
+  case ExportCounter::BisectionRequests:         return "bisectionRequests";
+  case ExportCounter::FilteredElements:          return "filteredElements";
+  case ExportCounter::PrefetchedElements:        return "prefetchedElements";
+  case ExportCounter::ClassificationCacheHits:   return "classificationCacheHits";
+  case ExportCounter::ClassificationCacheMisses: return "classificationCacheMisses";
+  default:                                       return "unknown";
+  }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "ACAPinc.h"
+#include "ContentHash.hpp"
+#include "TraceRecorder.hpp"
+#include "MemoryTracker.hpp"
+#include "Thirdparty/json.hpp"
+
+#include <array>
+#include <chrono>
+#include <string_view>
+
+using json = nlohmann::json;
+
+/**
+ * @brief The phases of an export that are timed in the export report
+ */
+enum class ExportPhase
+{
+  TypeResolution,
+  GuidCollection,
+  HeaderFetch,
+  ClassificationFetch,
+  DefinitionFetch,
+  ValueFetch,
+  Parse,
+  Serialize,
+  Write,
+  Upload,
+  Count
+};
+
+/**
+ * @brief The quantities counted in the export report
+ */
+enum class ExportCounter
+{
+  Elements,
+  Properties,
+  BytesSerialized,
+  BytesWritten,
+  BytesUploaded,
+  CacheHits,
+  CacheMisses,
+  Failures,
+  HeaderFetches,
+  PropertyCacheHits,
+  PropertyCacheMisses,
+  FailingDefinitions,
+  BisectionRequests,
+  FilteredElements,
+  PrefetchedElements,
+  ClassificationCacheHits,
+  ClassificationCacheMisses,
+  Count
+};
+
+/**
+ * @brief Collects the wall time spent in each phase of an export, measured with a monotonic clock, along with
+ * counters of the work done and the memory used. The report can be written out as json alongside the exported data.
+ * As phases can overlap, such as writing and uploading at once, the total time is measured separately, from when
+ * the report is created at the start of the export until Finish is called once its work is done.
+ */
+class ExportReport {
+public:
+  /**
+   * @brief Adds the time between construction and destruction (or Stop) to the given phase, and records it as
+   * a trace span when tracing is enabled
+   */
+  class ScopedPhase {
+  public:
+    ScopedPhase(ExportReport& report, ExportPhase phase);
+    ~ScopedPhase();
+
+    void Stop();
+
+  private:
+    ExportReport& m_report;
+    ExportPhase m_phase;
+    std::chrono::steady_clock::time_point m_start;
+    bool m_isStopped;
+    TraceRecorder::ScopedSpan m_span;
+  };
+
+  ExportReport();
+
+  void Finish();
+  void AddPhaseDuration(ExportPhase phase, double milliseconds);
+  void AddCount(ExportCounter counter, UInt64 count = 1);
+  void AddCounts(const ExportReport& other);
+  double GetPhaseDuration(ExportPhase phase) const;
+  double GetTotalDuration() const;
+  UInt64 GetCount(ExportCounter counter) const;
+
+  void HashOutput(std::string_view data);
+  UInt64 GetOutputHash() const;
+
+  MemoryTracker& GetMemory();
+  const MemoryTracker& GetMemory() const;
+
+  GS::UniString GetSummary() const;
+  json ToJson() const;
+
+  static const char* GetPhaseName(ExportPhase phase);
+  static const char* GetCounterName(ExportCounter counter);
+
+private:
+  std::chrono::steady_clock::time_point m_start;
+  std::chrono::steady_clock::time_point m_end;
+  bool m_isFinished;
+  std::array<double, static_cast<size_t>(ExportPhase::Count)> m_phaseMilliseconds;
+  std::array<UInt64, static_cast<size_t>(ExportCounter::Count)> m_counts;
+  ContentHash m_outputHash;
+  MemoryTracker m_memory;
+};
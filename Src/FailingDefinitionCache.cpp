@@ -0,0 +1,117 @@
+#include "FailingDefinitionCache.hpp"
+#include "ContentHash.hpp"
+
+/**
+ * @brief Obtains the cache shared by every export in the session
+ */
+FailingDefinitionCache& FailingDefinitionCache::GetSessionCache()
+{
+  static FailingDefinitionCache sessionCache;
+  return sessionCache;
+}
+
+/**
+ * @brief Obtains the property values of an element, leaving out definitions known to fail for its type. If the
+ * request fails, its definitions are bisected to obtain the values of the rest and to find the failing ones.
+ * @param[in] elemGuid The guid of the element
+ * @param[in] elemTypeId The type of the element
+ * @param[in] definitionGuids The guids of the property definitions to obtain values for
+ * @param[in] definitionsHash The hash of the property definitions
+ * @param[in] report Report counting the failing definitions found and the requests made to find them
+ * @param[out] properties The property values obtained
+ * @returns True if any property values were obtained
+ */
+bool FailingDefinitionCache::GetPropertyValues(const API_Guid& elemGuid, API_ElemTypeID elemTypeId, const GS::Array<API_Guid>& definitionGuids, UInt64 definitionsHash, ExportReport& report, GS::Array<API_Property>& properties)
+{
+  const GS::Array<API_Guid>* requestGuids = &definitionGuids;
+  GS::Array<API_Guid> usableGuids;
+  auto failingIt = m_failingDefinitions.find(elemTypeId);
+  if (failingIt != m_failingDefinitions.end())
+  {
+    for (const API_Guid& definitionGuid : definitionGuids)
+    {
+      if (!failingIt->second.Contains(APIGuid2GSGuid(definitionGuid)))
+        usableGuids.Push(definitionGuid);
+    }
+    requestGuids = &usableGuids;
+  }
+
+  if (requestGuids->IsEmpty())
+    return false;
+
+  properties.Clear();
+  if (ACAPI_Element_GetPropertyValuesByGuid(elemGuid, *requestGuids, properties) == NoError)
+    return !properties.IsEmpty();
+
+  // Definition sets that failed as a whole before are not bisected again, nor are single definitions, as the
+  // element rather than its definitions may be at fault
+  ContentHash setHash;
+  setHash.Append(&definitionsHash, sizeof(definitionsHash));
+  setHash.Append(&elemTypeId, sizeof(API_ElemTypeID));
+  UInt64 setKey = setHash.GetValue();
+  if (requestGuids->GetSize() < 2 || m_failingSets.count(setKey) > 0)
+    return false;
+
+  properties.Clear();
+  GS::Array<API_Guid> failingGuids;
+  if (!BisectDefinitions(elemGuid, *requestGuids, report, properties, failingGuids))
+  {
+    m_failingSets.insert(setKey);
+    return false;
+  }
+
+  GS::HashSet<GS::Guid>& typeFailingDefinitions = m_failingDefinitions[elemTypeId];
+  for (const API_Guid& failingGuid : failingGuids)
+  {
+    if (typeFailingDefinitions.Add(APIGuid2GSGuid(failingGuid)))
+    {
+      ++m_definitionCount;
+      report.AddCount(ExportCounter::FailingDefinitions);
+    }
+  }
+  return !properties.IsEmpty();
+}
+
+void FailingDefinitionCache::Clear()
+{
+  m_failingDefinitions.clear();
+  m_failingSets.clear();
+  m_definitionCount = 0;
+}
+
+UInt32 FailingDefinitionCache::GetDefinitionCount() const
+{
+  return m_definitionCount;
+}
+
+bool FailingDefinitionCache::BisectDefinitions(const API_Guid& elemGuid, const GS::Array<API_Guid>& definitionGuids, ExportReport& report, GS::Array<API_Property>& properties, GS::Array<API_Guid>& failingGuids)
+{
+  // Request each half of the definitions on its own, splitting the halves that fail in turn until the failing
+  // definitions are left on their own
+  bool isAnySucceeded = false;
+  USize halfSize = definitionGuids.GetSize() / 2;
+  for (USize partStart : { static_cast<USize>(0), halfSize })
+  {
+    USize partEnd = partStart == 0 ? halfSize : definitionGuids.GetSize();
+    GS::Array<API_Guid> partGuids;
+    for (USize i = partStart; i < partEnd; ++i)
+      partGuids.Push(definitionGuids[i]);
+
+    GS::Array<API_Property> partProperties;
+    report.AddCount(ExportCounter::BisectionRequests);
+    if (ACAPI_Element_GetPropertyValuesByGuid(elemGuid, partGuids, partProperties) == NoError)
+    {
+      properties.Append(partProperties);
+      isAnySucceeded = true;
+    }
+    else if (partGuids.GetSize() == 1)
+    {
+      failingGuids.Push(partGuids[0]);
+    }
+    else if (BisectDefinitions(elemGuid, partGuids, report, properties, failingGuids))
+    {
+      isAnySucceeded = true;
+    }
+  }
+  return isAnySucceeded;
+}
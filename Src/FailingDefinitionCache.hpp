@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ACAPinc.h"
+#include "ExportReport.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @brief Property definitions whose values Archicad fails to obtain for an element type, kept for the rest of the
+ * session. Requesting values for such a definition fails the request for every definition in it, so when a request
+ * fails its definitions are bisected to find the failing ones. Later elements of the same type are then requested
+ * without them, obtaining the rest of their values with a single request.
+ */
+class FailingDefinitionCache {
+public:
+  static FailingDefinitionCache& GetSessionCache();
+
+  bool GetPropertyValues(const API_Guid& elemGuid, API_ElemTypeID elemTypeId, const GS::Array<API_Guid>& definitionGuids, UInt64 definitionsHash, ExportReport& report, GS::Array<API_Property>& properties);
+
+  void Clear();
+
+  UInt32 GetDefinitionCount() const;
+
+private:
+  bool BisectDefinitions(const API_Guid& elemGuid, const GS::Array<API_Guid>& definitionGuids, ExportReport& report, GS::Array<API_Property>& properties, GS::Array<API_Guid>& failingGuids);
+
+  std::unordered_map<API_ElemTypeID, GS::HashSet<GS::Guid>> m_failingDefinitions;
+  std::unordered_set<UInt64> m_failingSets;
+  UInt32 m_definitionCount = 0;
+};
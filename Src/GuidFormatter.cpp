@@ -0,0 +1,104 @@
+#include "GuidFormatter.hpp"
+#include "CpuFeatures.hpp"
+
+#include <cstring>
+
+#ifdef EXPORT_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const size_t ByteCount = 16;
+
+/**
+ * @brief Writes the bytes of a guid in the order they are printed, with its leading integer fields big-endian
+ */
+void GetPrintedBytes(const API_Guid& guid, UInt8* bytes)
+{
+  bytes[0] = static_cast<UInt8>(guid.time_low >> 24);
+  bytes[1] = static_cast<UInt8>(guid.time_low >> 16);
+  bytes[2] = static_cast<UInt8>(guid.time_low >> 8);
+  bytes[3] = static_cast<UInt8>(guid.time_low);
+  bytes[4] = static_cast<UInt8>(guid.time_mid >> 8);
+  bytes[5] = static_cast<UInt8>(guid.time_mid);
+  bytes[6] = static_cast<UInt8>(guid.time_hi_and_version >> 8);
+  bytes[7] = static_cast<UInt8>(guid.time_hi_and_version);
+  bytes[8] = guid.clock_seq_hi_and_reserved;
+  bytes[9] = guid.clock_seq_low;
+  std::memcpy(bytes + 10, guid.node, 6);
+}
+
+#ifdef EXPORT_SIMD_SSE2
+
+__m128i NibblesToHex(__m128i nibbles)
+{
+  // Digits map to '0'-'9', and nibbles above 9 are moved up to 'A'-'F'
+  __m128i letterOffset = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+  return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letterOffset);
+}
+
+void BytesToHex(const UInt8* bytes, char* hex)
+{
+  // Split each byte into its high and low nibbles, then interleave them so the high nibble is printed first
+  __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+  __m128i nibbleMask = _mm_set1_epi8(0x0F);
+  __m128i high = _mm_and_si128(_mm_srli_epi16(input, 4), nibbleMask);
+  __m128i low = _mm_and_si128(input, nibbleMask);
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(hex), NibblesToHex(_mm_unpacklo_epi8(high, low)));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(hex + 16), NibblesToHex(_mm_unpackhi_epi8(high, low)));
+}
+
+#else
+
+void BytesToHex(const UInt8* bytes, char* hex)
+{
+  static const char HexDigits[] = "0123456789ABCDEF";
+
+  for (size_t i = 0; i < ByteCount; ++i)
+  {
+    hex[2 * i] = HexDigits[bytes[i] >> 4];
+    hex[2 * i + 1] = HexDigits[bytes[i] & 0x0F];
+  }
+}
+
+#endif
+
+}
+
+/**
+ * @brief Writes the text of a guid, without a terminating null character
+ * @param[in] guid The guid to format
+ * @param[out] output The buffer to write to, which must hold at least Length characters
+ */
+void GuidFormatter::Format(const API_Guid& guid, char* output)
+{
+  UInt8 bytes[ByteCount];
+  char hex[2 * ByteCount];
+  GetPrintedBytes(guid, bytes);
+  BytesToHex(bytes, hex);
+
+  // Lay the digits out in groups of 8-4-4-4-12
+  std::memcpy(output, hex, 8);
+  output[8] = '-';
+  std::memcpy(output + 9, hex + 8, 4);
+  output[13] = '-';
+  std::memcpy(output + 14, hex + 12, 4);
+  output[18] = '-';
+  std::memcpy(output + 19, hex + 16, 4);
+  output[23] = '-';
+  std::memcpy(output + 24, hex + 20, 12);
+}
+
+/**
+ * @brief Appends the text of a guid to a string
+ * @param[out] output The string to append to
+ * @param[in] guid The guid to format
+ */
+void GuidFormatter::Append(std::string& output, const API_Guid& guid)
+{
+  char text[Length];
+  Format(guid, text);
+  output.append(text, Length);
+}
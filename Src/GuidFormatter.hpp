@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ACAPinc.h"
+
+#include <string>
+
+/**
+ * @brief Formats guids as their canonical 36 character text, e.g. 0D8E3A4C-12F0-4B7D-9C21-5A6B7C8D9E0F, without
+ * allocating. The text is identical to that of APIGuidToString.
+ */
+class GuidFormatter {
+public:
+  GuidFormatter() = delete; // prevent instantiation of this class
+
+  static const size_t Length = 36;
+
+  static void Format(const API_Guid& guid, char* output);
+  static void Append(std::string& output, const API_Guid& guid);
+};
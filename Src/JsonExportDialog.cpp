@@ -1,6 +1,9 @@
 #include "JsonExportDialog.hpp"
 #include "JsonExportUtils.hpp"
 
+const static Int32 ProgressBarMax = 1000;
+const static Int32 DefaultRealDecimalPlaces = 3;
+
 JsonExportDialog::JsonExportDialog() :
   DG::ModalDialog(ACAPI_GetOwnResModule(), ExampleDialogResourceId, ACAPI_GetOwnResModule()),
   m_useSelectionElementsCheckbox(GetReference(), UseSelectionElementsCheckboxId),
@@ -18,25 +21,67 @@ JsonExportDialog::JsonExportDialog() :
   m_urlTextEdit(GetReference(), UrlTextEditId),
   m_separator2(GetReference(), Separator2_Id),
   m_closeButton(GetReference(), CloseButtonId),
-  m_exportButton(GetReference(), ExportButtonId)
+  m_exportButton(GetReference(), ExportButtonId),
+  m_arrowFormatCheckbox(GetReference(), ArrowFormatCheckboxId),
+  m_propertiesLabel(GetReference(), PropertiesLabelId),
+  m_propertiesTextEdit(GetReference(), PropertiesTextEditId),
+  m_traceCheckbox(GetReference(), TraceCheckboxId),
+  m_memoryBudgetLabel(GetReference(), MemoryBudgetLabelId),
+  m_memoryBudgetEdit(GetReference(), MemoryBudgetEditId),
+  m_progressText(GetReference(), ProgressTextId),
+  m_progressBar(GetReference(), ProgressBarId),
+  m_realPrecisionCheckbox(GetReference(), RealPrecisionCheckboxId),
+  m_realDecimalPlacesEdit(GetReference(), RealDecimalPlacesEditId),
+  m_reuseValuesCheckbox(GetReference(), ReuseValuesCheckboxId),
+  m_storeyCheckbox(GetReference(), StoreyCheckboxId),
+  m_minStoreyEdit(GetReference(), MinStoreyEditId),
+  m_storeyRangeLabel(GetReference(), StoreyRangeLabelId),
+  m_maxStoreyEdit(GetReference(), MaxStoreyEditId),
+  m_visibleLayersCheckbox(GetReference(), VisibleLayersCheckboxId),
+  m_classificationsLabel(GetReference(), ClassificationsLabelId),
+  m_classificationsTextEdit(GetReference(), ClassificationsTextEditId),
+  m_estimateButton(GetReference(), EstimateButtonId),
+  m_serveCheckbox(GetReference(), ServeCheckboxId),
+  m_serverPortEdit(GetReference(), ServerPortEditId)
 {
   AttachToAllItems(*this);
   Attach(*this);
   InitDialog();
+  EnableIdleEvent();
 }
 
 JsonExportDialog::~JsonExportDialog()
 {
+  // The project may change once the dialog is closed, so a running export is abandoned without showing anything, and
+  // elements collected ahead of an export are discarded
+  JsonExportUtils::AbandonExportJob();
+  JsonExportUtils::ClearPrefetch();
   Detach(*this);
   DetachFromAllItems(*this);
 }
 
 void JsonExportDialog::ButtonClicked(const DG::ButtonClickEvent& ev)
 {
+  // Exports run in slices of idle time, during which the export button cancels the export
   if (ev.GetSource() == &m_exportButton)
   {
-    auto settingsData = GetSettingsData();
-    JsonExportUtils::RunExportProcess(settingsData);
+    if (JsonExportUtils::IsExportJobRunning())
+    {
+      JsonExportUtils::CancelExportJob();
+    }
+    else
+    {
+      auto settingsData = GetSettingsData();
+      JsonExportUtils::StartExportJob(settingsData, this);
+      m_exportButton.SetText("Cancel");
+    }
+  }
+
+  if (ev.GetSource() == &m_estimateButton)
+  {
+    ExportEstimate estimate;
+    JsonExportUtils::EstimateExport(GetSettingsData(), estimate);
+    ShowEstimate(estimate);
   }
 
   if (ev.GetSource() == &m_closeButton)
@@ -100,20 +145,88 @@ void JsonExportDialog::CheckItemChanged(const DG::CheckItemChangeEvent& ev)
     else
       m_urlTextEdit.Disable();
   }
+  if (ev.GetSource() == &m_serveCheckbox)
+  {
+    if (m_serveCheckbox.IsChecked())
+      m_serverPortEdit.Enable();
+    else
+      m_serverPortEdit.Disable();
+  }
 
-  // Disable export button if either no filters or file path and url are not checked
+  // Handle real value precision checkbox
+  if (ev.GetSource() == &m_realPrecisionCheckbox)
+  {
+    if (m_realPrecisionCheckbox.IsChecked())
+      m_realDecimalPlacesEdit.Enable();
+    else
+      m_realDecimalPlacesEdit.Disable();
+  }
+
+  // Handle storey range checkbox
+  if (ev.GetSource() == &m_storeyCheckbox)
+  {
+    if (m_storeyCheckbox.IsChecked())
+    {
+      m_minStoreyEdit.Enable();
+      m_maxStoreyEdit.Enable();
+    }
+    else
+    {
+      m_minStoreyEdit.Disable();
+      m_maxStoreyEdit.Disable();
+    }
+  }
+
+  // Disable export button if either no filters or none of file path, url and local server are checked
   bool allFiltersUnchecked =
     !m_userDefinedCheckbox.IsChecked() &&
     !m_fundamentalCheckbox.IsChecked() &&
     !m_userLevelCheckbox.IsChecked() &&
     !m_allPropertyCheckbox.IsChecked();
 
-  bool allExportsUnchecked = !m_filePathCheckBox.IsChecked() && !m_urlCheckBox.IsChecked();
+  bool allExportsUnchecked = !m_filePathCheckBox.IsChecked() && !m_urlCheckBox.IsChecked() && !m_serveCheckbox.IsChecked();
 
-  if (allFiltersUnchecked || allExportsUnchecked)
+  if ((allFiltersUnchecked || allExportsUnchecked) && !JsonExportUtils::IsExportJobRunning())
     m_exportButton.Disable();
   else
     m_exportButton.Enable();
+
+  // Estimates only need property filters, as they do not export anything
+  if (allFiltersUnchecked)
+    m_estimateButton.Disable();
+  else
+    m_estimateButton.Enable();
+}
+
+void JsonExportDialog::PanelIdle(const DG::PanelIdleEvent& ev)
+{
+  // Run a slice of the running export, otherwise collect elements for the current settings while waiting for the
+  // user, so that an export finds them collected
+  if (JsonExportUtils::IsExportJobRunning())
+  {
+    if (!JsonExportUtils::RunExportJobSlice())
+      m_exportButton.SetText("Export");
+  }
+  else
+  {
+    JsonExportUtils::RunPrefetchSlice(GetSettingsData());
+  }
+}
+
+void JsonExportDialog::ProgressChanged(const ExportProgress& progress)
+{
+  // Show progress through the current phase, along with the estimated time remaining
+  GS::UniString text = ExportProgressReporter::GetPhaseDescription(progress.phase);
+  if (progress.itemsTotal > 0)
+    text += GS::UniString::Printf(": %llu / %llu", static_cast<unsigned long long>(progress.itemsDone), static_cast<unsigned long long>(progress.itemsTotal));
+  if (progress.etaSeconds >= 0.0)
+    text += GS::UniString::Printf(" (%.0f s remaining)", progress.etaSeconds);
+
+  Int32 value = progress.itemsTotal > 0 ? static_cast<Int32>(ProgressBarMax * progress.itemsDone / progress.itemsTotal) : 0;
+  m_progressText.SetText(text);
+  m_progressText.Redraw();
+  m_progressBar.SetValue(value);
+  m_progressBar.Redraw();
 }
 
 void JsonExportDialog::InitDialog()
@@ -143,6 +256,53 @@ void JsonExportDialog::InitDialog()
   // Init file path / link export options
   m_filePathCheckBox.Check();
   m_urlTextEdit.Disable();
+
+  // Init memory budget
+  m_memoryBudgetEdit.SetValue(DefaultMemoryBudgetMegabytes);
+
+  // Init real value precision, writing real values in full unless rounding is requested
+  m_realDecimalPlacesEdit.SetValue(DefaultRealDecimalPlaces);
+  m_realDecimalPlacesEdit.Disable();
+
+  // Init reuse of property values from previous exports
+  m_reuseValuesCheckbox.Check();
+
+  // Init storey range, exporting elements on every storey unless a range is requested
+  m_minStoreyEdit.SetValue(0);
+  m_minStoreyEdit.Disable();
+  m_maxStoreyEdit.SetValue(0);
+  m_maxStoreyEdit.Disable();
+
+  // Init local server, which only serves element data once requested
+  m_serverPortEdit.SetValue(DefaultServerPort);
+  m_serverPortEdit.Disable();
+
+  // Init progress display
+  m_progressBar.SetMin(0);
+  m_progressBar.SetMax(ProgressBarMax);
+  m_progressBar.SetValue(0);
+}
+
+void JsonExportDialog::ShowEstimate(const ExportEstimate& estimate)
+{
+  if (estimate.sampledElements == 0)
+  {
+    m_progressText.SetText("Estimate: no elements to export");
+    m_progressText.Redraw();
+    return;
+  }
+
+  // Show the estimate for the chosen format, with the other format for comparison
+  bool isArrowFormat = m_arrowFormatCheckbox.IsChecked();
+  double megabytes = (isArrowFormat ? estimate.arrowBytes : estimate.jsonBytes) / (1024.0 * 1024.0);
+  double seconds = isArrowFormat ? estimate.arrowSeconds : estimate.jsonSeconds;
+  double otherMegabytes = (isArrowFormat ? estimate.jsonBytes : estimate.arrowBytes) / (1024.0 * 1024.0);
+  double otherSeconds = isArrowFormat ? estimate.jsonSeconds : estimate.arrowSeconds;
+
+  m_progressText.SetText(GS::UniString::Printf("Estimate: %.1f MB in %.0f s (%s: %.1f MB in %.0f s), sampled %llu of %llu elements",
+    megabytes, seconds, isArrowFormat ? "JSON" : "Arrow", otherMegabytes, otherSeconds,
+    static_cast<unsigned long long>(estimate.sampledElements), static_cast<unsigned long long>(estimate.candidateElements)));
+  m_progressText.Redraw();
 }
 
 void JsonExportDialog::UpdateAvailableElementTypes()
@@ -165,10 +325,6 @@ void JsonExportDialog::UpdateAvailableElementTypes()
 
 JsonExportSettingsData JsonExportDialog::GetSettingsData() const
 {
-  auto elementNames = m_elementTypesTextEdit.GetText().Split(",");
-  for (GS::UniString& name : elementNames)
-    name.Trim();
-
   return JsonExportSettingsData
   {
     m_filePathTextEdit.GetText(),
@@ -176,11 +332,38 @@ JsonExportSettingsData JsonExportDialog::GetSettingsData() const
     m_filePathCheckBox.IsChecked(),
     m_urlCheckBox.IsChecked(),
     GetPropertyDefinitionFilters(),
-    elementNames,
-    m_useSelectionElementsCheckbox.IsChecked()
+    GetCommaSeparatedValues(m_propertiesTextEdit),
+    GetCommaSeparatedValues(m_elementTypesTextEdit),
+    m_useSelectionElementsCheckbox.IsChecked(),
+    m_arrowFormatCheckbox.IsChecked() ? ExportFormat::Arrow : ExportFormat::Json,
+    DefaultPropertyBatchSize,
+    m_traceCheckbox.IsChecked(),
+    m_memoryBudgetEdit.GetValue(),
+    m_realPrecisionCheckbox.IsChecked() ? m_realDecimalPlacesEdit.GetValue() : ShortestRealDecimalPlaces,
+    m_reuseValuesCheckbox.IsChecked(),
+    m_storeyCheckbox.IsChecked(),
+    m_minStoreyEdit.GetValue(),
+    m_maxStoreyEdit.GetValue(),
+    m_visibleLayersCheckbox.IsChecked(),
+    GetCommaSeparatedValues(m_classificationsTextEdit),
+    m_serveCheckbox.IsChecked(),
+    m_serverPortEdit.GetValue()
   };
 }
 
+GS::Array<GS::UniString> JsonExportDialog::GetCommaSeparatedValues(const DG::MultiLineEdit& textEdit) const
+{
+  // Split text into trimmed values, ignoring any empty entries
+  GS::Array<GS::UniString> values;
+  for (GS::UniString& value : textEdit.GetText().Split(","))
+  {
+    value.Trim();
+    if (!value.IsEmpty())
+      values.Push(value);
+  }
+  return values;
+}
+
 GS::Array<API_PropertyDefinitionFilter> JsonExportDialog::GetPropertyDefinitionFilters() const
 {
   if (m_allPropertyCheckbox.IsChecked())
@@ -1,16 +1,20 @@
 #pragma once
 
 #include "JsonExportSettingsData.hpp"
+#include "ExportProgress.hpp"
 
 #include "ResourceIds.hpp"
 #include "DGModule.hpp"
 
+struct ExportEstimate;
+
 class JsonExportDialog :
   public DG::ModalDialog,
   public DG::PanelObserver,
   public DG::CompoundItemObserver,
   public DG::ButtonItemObserver,
-  public DG::CheckItemObserver
+  public DG::CheckItemObserver,
+  public ExportProgressListener
 {
 public:
   enum DialogResourceIds
@@ -31,7 +35,28 @@ public:
     UrlTextEditId = 13,
     Separator2_Id = 14,
     CloseButtonId = 15,
-    ExportButtonId = 16
+    ExportButtonId = 16,
+    ArrowFormatCheckboxId = 17,
+    PropertiesLabelId = 18,
+    PropertiesTextEditId = 19,
+    TraceCheckboxId = 20,
+    MemoryBudgetLabelId = 21,
+    MemoryBudgetEditId = 22,
+    ProgressTextId = 23,
+    ProgressBarId = 24,
+    RealPrecisionCheckboxId = 25,
+    RealDecimalPlacesEditId = 26,
+    ReuseValuesCheckboxId = 27,
+    StoreyCheckboxId = 28,
+    MinStoreyEditId = 29,
+    StoreyRangeLabelId = 30,
+    MaxStoreyEditId = 31,
+    VisibleLayersCheckboxId = 32,
+    ClassificationsLabelId = 33,
+    ClassificationsTextEditId = 34,
+    EstimateButtonId = 35,
+    ServeCheckboxId = 36,
+    ServerPortEditId = 37
   };
 
   JsonExportDialog();
@@ -40,11 +65,15 @@ public:
 private:
   virtual void ButtonClicked(const DG::ButtonClickEvent& ev) override;
   virtual void CheckItemChanged(const DG::CheckItemChangeEvent& ev) override;
+  virtual void ProgressChanged(const ExportProgress& progress) override;
+  virtual void PanelIdle(const DG::PanelIdleEvent& ev) override;
 
   void InitDialog();
   void UpdateAvailableElementTypes();
+  void ShowEstimate(const ExportEstimate& estimate);
 
   JsonExportSettingsData GetSettingsData() const;
+  GS::Array<GS::UniString> GetCommaSeparatedValues(const DG::MultiLineEdit& textEdit) const;
   GS::Array<API_PropertyDefinitionFilter> GetPropertyDefinitionFilters() const;
 
   DG::CheckBox m_useSelectionElementsCheckbox;
@@ -63,4 +92,25 @@ private:
   DG::Separator	m_separator2;
   DG::Button m_exportButton;
   DG::Button m_closeButton;
+  DG::CheckBox m_arrowFormatCheckbox;
+  DG::LeftText m_propertiesLabel;
+  DG::MultiLineEdit m_propertiesTextEdit;
+  DG::CheckBox m_traceCheckbox;
+  DG::LeftText m_memoryBudgetLabel;
+  DG::PosIntEdit m_memoryBudgetEdit;
+  DG::LeftText m_progressText;
+  DG::ProgressBar m_progressBar;
+  DG::CheckBox m_realPrecisionCheckbox;
+  DG::IntEdit m_realDecimalPlacesEdit;
+  DG::CheckBox m_reuseValuesCheckbox;
+  DG::CheckBox m_storeyCheckbox;
+  DG::IntEdit m_minStoreyEdit;
+  DG::LeftText m_storeyRangeLabel;
+  DG::IntEdit m_maxStoreyEdit;
+  DG::CheckBox m_visibleLayersCheckbox;
+  DG::LeftText m_classificationsLabel;
+  DG::MultiLineEdit m_classificationsTextEdit;
+  DG::Button m_estimateButton;
+  DG::CheckBox m_serveCheckbox;
+  DG::PosIntEdit m_serverPortEdit;
 };
\ No newline at end of file
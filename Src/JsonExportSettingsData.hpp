@@ -2,6 +2,20 @@
 
 #include "ACAPinc.h"
 
+/**
+ * @brief The file formats that element data can be exported in
+ */
+enum class ExportFormat
+{
+  Json,
+  Arrow
+};
+
+const UInt32 DefaultPropertyBatchSize = 256;
+const UInt32 DefaultMemoryBudgetMegabytes = 2048;
+const Int32 ShortestRealDecimalPlaces = -1;
+const UInt32 DefaultServerPort = 8080;
+
 /**
  * @brief Describes the data required for implementing element parsing and export
  */
@@ -12,6 +26,20 @@ struct JsonExportSettingsData
   bool exportToFile;
   bool exportToUrl;
   GS::Array<API_PropertyDefinitionFilter> propertyDefinitionFilters;
+  GS::Array<GS::UniString> propertyAllowList;
   GS::Array<GS::UniString> elemTypeNames;
   bool selectedOnly;
+  ExportFormat exportFormat;
+  UInt32 propertyBatchSize = DefaultPropertyBatchSize;
+  bool recordTrace = false;
+  UInt32 memoryBudgetMegabytes = DefaultMemoryBudgetMegabytes;
+  Int32 realDecimalPlaces = ShortestRealDecimalPlaces;
+  bool reuseUnchangedValues = true;
+  bool filterStoreys = false;
+  Int32 minStorey = 0;
+  Int32 maxStorey = 0;
+  bool visibleLayersOnly = false;
+  GS::Array<GS::UniString> classifications;
+  bool serveLocally = false;
+  UInt32 serverPort = DefaultServerPort;
 };
\ No newline at end of file
@@ -1,46 +1,348 @@
 #include "JsonExportUtils.hpp"
 #include "JsonParser.hpp"
+#include "JsonWriter.hpp"
+#include "ArrowSerializer.hpp"
+#include "ContentHash.hpp"
 #include "DataExporter.hpp"
+#include "FailingDefinitionCache.hpp"
+#include "GuidFormatter.hpp"
+#include "QueryServer.hpp"
+#include "TraceRecorder.hpp"
 #include "DG.h"
 
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <future>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+
 const static int JsonIndentWidth = 2;
+const static char* ReportFileName = "export-report.json";
+const static char* TraceFileName = "export-trace.json";
+const static char* PlanFileName = "export-plan.json";
+const static char* TemporaryFilePrefix = "archicad-export-";
+
+// Estimated memory for a property's string bytes and serialized output, on top of its entries in the element store
+const static UInt64 EstimatedPropertyValueBytes = 128;
+
+// Estimates sample at most this many candidate elements, in groups of this size, for at most this long, of which
+// listing the candidates takes at most the last duration
+const static USize MaxEstimateSampleSize = 64;
+const static USize EstimateSampleGroupSize = 8;
+const static double EstimateSampleSeconds = 0.3;
+const static double EstimateListSeconds = 0.1;
+
+// Idle-time collection runs in slices of at most this length, each made of steps listing or collecting up to this
+// many elements
+const static std::chrono::milliseconds PrefetchSliceDuration{ 20 };
+const static USize PrefetchGroupSize = 32;
+
+// Exports run in slices of idle time of at most this length, each made of steps collecting or fetching up to this
+// many elements
+const static std::chrono::milliseconds ExportJobSliceDuration{ 16 };
+const static USize ExportJobGroupSize = 8;
+
+// Batched exports write their output to file in chunks of at least this size
+const static size_t IncrementalChunkBytes = 1024 * 1024;
+
+// Reported when an export to the local server is too large to hold within the memory budget
+const static char* ServerOverBudgetError = "Too many elements to serve within the memory budget";
+
+// Memory held for each element awaiting its property values
+const static UInt64 PendingElementBytes = sizeof(API_Guid) + sizeof(API_ElemTypeID) + sizeof(UInt32) + sizeof(UInt64) + sizeof(size_t);
 
 /**
- * @brief Runs the process for collecting, parsing and exporting element data from the project
- * @param[in] settingsData Settings for determining what element data to extract
+ * @brief Estimates the output size and duration of an export in each format. A small random sample of the candidate
+ * elements is collected, fetched and serialized, and the cost per candidate is extrapolated to every candidate.
+ * Listing and sampling stop early once they have taken long enough for a reliable estimate, so that the estimate
+ * stays quick on large models. Values fetched for the sample are not added to the property cache, nor are failing
+ * definitions found in the sample remembered for the session.
+ * @param[in] settingsData Settings of the export to estimate
+ * @param[out] estimate The estimated output bytes and durations
  */
-void JsonExportUtils::RunExportProcess(const JsonExportSettingsData& settingsData)
+void JsonExportUtils::EstimateExport(const JsonExportSettingsData& settingsData, ExportEstimate& estimate)
 {
-  // Obtain all element types and guids
-  GS::Array<API_ElemTypeID> elemTypes;
-  GetElementTypesFromNames(settingsData.elemTypeNames, elemTypes);
+  estimate = {};
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  auto secondsSince = [](std::chrono::steady_clock::time_point time)
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - time).count();
+  };
 
-  GS::Array<API_Guid> elemGuids;
+  // Selected elements are sampled before being filtered by type, so that only the sample's headers are fetched
+  bool isPlanReused;
+  std::shared_ptr<const ExportPlan> sessionPlan = ExportPlan::GetSessionPlan(settingsData, isPlanReused);
+  const ExportPlan& plan = *sessionPlan;
+  CancellationToken cancellationToken;
+  std::mt19937 random(std::random_device{}());
+  GS::Array<API_Guid> candidateGuids;
+  double candidateScale = 1.0;
   if (settingsData.selectedOnly)
   {
-    GS::Array<API_Guid> selectedGuids;
-    GetSelectedElements(selectedGuids);
-    FilterElementsByType(elemTypes, selectedGuids, elemGuids);
+    GetSelectedElements(candidateGuids);
   }
   else
   {
-    GetElementsFromTypes(elemTypes, elemGuids);
+    // List element types in random order until the time for listing runs out, extrapolating the candidates of the
+    // types left unlisted from those of the listed ones
+    GS::Array<API_ElemTypeID> elemTypes = plan.GetElemTypes();
+    USize listedTypes = 0;
+    while (listedTypes < elemTypes.GetSize() && (candidateGuids.IsEmpty() || secondsSince(start) < EstimateListSeconds))
+    {
+      std::uniform_int_distribution<USize> distribution(listedTypes, elemTypes.GetSize() - 1);
+      std::swap(elemTypes[listedTypes], elemTypes[distribution(random)]);
+      GetElementsFromTypes({ elemTypes[listedTypes++] }, cancellationToken, candidateGuids);
+    }
+    if (listedTypes > 0)
+      candidateScale = static_cast<double>(elemTypes.GetSize()) / listedTypes;
+  }
+
+  estimate.candidateElements = static_cast<UInt64>(candidateGuids.GetSize() * candidateScale);
+  if (candidateGuids.IsEmpty())
+    return;
+  double listSeconds = secondsSince(start) * candidateScale;
+
+  // Move a random sample to the front of the listed candidates
+  USize sampleSize = std::min<USize>(candidateGuids.GetSize(), MaxEstimateSampleSize);
+  for (USize i = 0; i < sampleSize; ++i)
+  {
+    std::uniform_int_distribution<USize> distribution(i, candidateGuids.GetSize() - 1);
+    std::swap(candidateGuids[i], candidateGuids[distribution(random)]);
   }
 
-  // Construct data for parsing
-  GS::Array<ElementData> elemData;
-  BuildElementData(elemGuids, settingsData.propertyDefinitionFilters, elemData);
+  // Collect the sample a group at a time, for up to half of the sampling time, noting where each group ends in the
+  // candidates and pending elements
+  ExportReport report;
+  ExportProgressReporter progress(nullptr);
+  ElementFilter elementFilter(settingsData);
+  ElementHeaderCache headers;
+  PendingElements pending;
+  std::vector<std::pair<USize, size_t>> groupEnds;
+  std::vector<double> groupSeconds;
+  for (USize groupStart = 0; groupStart < sampleSize; groupStart += EstimateSampleGroupSize)
+  {
+    if (groupStart > 0 && secondsSince(start) >= EstimateSampleSeconds / 2)
+      break;
 
-  // Parse data to JSON
-  json exportJson;
-  JsonParser::Parse(elemData, exportJson);
+    std::chrono::steady_clock::time_point groupStartTime = std::chrono::steady_clock::now();
+    GS::Array<API_Guid> groupGuids;
+    for (USize i = groupStart; i < std::min(groupStart + EstimateSampleGroupSize, sampleSize); ++i)
+      groupGuids.Push(candidateGuids[i]);
 
-  // Export JSON to file and/or url
-  if (settingsData.exportToFile)
-    RunExportToFile(settingsData.filePath, exportJson);
+    GS::Array<API_Guid> elemGuids;
+    if (settingsData.selectedOnly)
+      FilterElementsByType(plan.GetElemTypes(), groupGuids, headers, report, elemGuids);
+    else
+      elemGuids = groupGuids;
 
-  if (settingsData.exportToUrl)
-    RunExportToUrl(settingsData.baseUrl, exportJson);
+    CollectElements(elemGuids, settingsData.propertyDefinitionFilters, plan.GetAllowList(), elementFilter, headers, report, cancellationToken, progress, pending);
+    groupEnds.emplace_back(groupStart + groupGuids.GetSize(), pending.elemGuids.size());
+    groupSeconds.push_back(secondsSince(groupStartTime));
+  }
+
+  // Fetch the values of each collected group in turn, until the time for sampling runs out. Definitions found to fail
+  // are only remembered for the sample.
+  FailingDefinitionCache failingDefinitions;
+  ElementStore store;
+  AddLayersToStore(pending, store);
+  double sampleSeconds = 0.0;
+  size_t pendingStart = 0;
+  for (size_t group = 0; group < groupEnds.size(); ++group)
+  {
+    if (group > 0 && secondsSince(start) >= EstimateSampleSeconds)
+      break;
+
+    std::chrono::steady_clock::time_point groupStartTime = std::chrono::steady_clock::now();
+    std::vector<size_t> elemIndices(groupEnds[group].second - pendingStart);
+    std::iota(elemIndices.begin(), elemIndices.end(), pendingStart);
+    FetchPropertyValues(pending, elemIndices, settingsData.propertyBatchSize, nullptr, failingDefinitions, report, cancellationToken, progress, store);
+
+    sampleSeconds += groupSeconds[group] + secondsSince(groupStartTime);
+    estimate.sampledElements = groupEnds[group].first;
+    pendingStart = groupEnds[group].second;
+  }
+
+  // Serialize the sample in both formats and extrapolate its cost to every candidate
+  std::chrono::steady_clock::time_point serializeStart = std::chrono::steady_clock::now();
+  JsonWriter writer(JsonIndentWidth);
+  writer.SetRealDecimalPlaces(settingsData.realDecimalPlaces);
+  std::vector<GS::UniString> elemTypeNames;
+  ResolveElemTypeNames(store, elemTypeNames);
+  JsonParser::Parse(store, elemTypeNames, report, cancellationToken, writer);
+  double jsonSeconds = secondsSince(serializeStart);
+
+  serializeStart = std::chrono::steady_clock::now();
+  std::string arrowData;
+  ArrowSerializer::Serialize(store, elemTypeNames, report, arrowData);
+  double arrowSeconds = secondsSince(serializeStart);
+
+  double scale = static_cast<double>(estimate.candidateElements) / estimate.sampledElements;
+  estimate.jsonBytes = static_cast<UInt64>(writer.GetBuffer().size() * scale);
+  estimate.jsonSeconds = listSeconds + (sampleSeconds + jsonSeconds) * scale;
+  estimate.arrowBytes = static_cast<UInt64>(arrowData.size() * scale);
+  estimate.arrowSeconds = listSeconds + (sampleSeconds + arrowSeconds) * scale;
+}
+
+/**
+ * @brief Collects elements for an export with the given settings ahead of time, for up to a short slice of idle time.
+ * Work done for different collection settings is discarded first. As the export dialog is modal, the project cannot
+ * change while the work is held, but it must be cleared with ClearPrefetch once the dialog closes.
+ * @param[in] settingsData Settings of the export to collect elements for
+ * @returns True if there is more work to do for these settings
+ */
+bool JsonExportUtils::RunPrefetchSlice(const JsonExportSettingsData& settingsData)
+{
+  std::unique_ptr<PrefetchState>& state = GetPrefetchState();
+  if (state == nullptr || state->fingerprint != ExportPlan::GetCollectionFingerprint(settingsData))
+    state = std::make_unique<PrefetchState>(settingsData);
+  else if (state->isListed && state->collectedCount >= state->elemGuids.GetSize())
+    return false;
+
+  bool isPlanReused;
+  std::shared_ptr<const ExportPlan> sessionPlan = ExportPlan::GetSessionPlan(settingsData, isPlanReused);
+  PrefetchState& prefetch = *state;
+  return prefetch.slicer.RunSlice([&sessionPlan, &settingsData, &prefetch](USize groupSize)
+  {
+    return RunPrefetchStep(*sessionPlan, settingsData, prefetch, groupSize, prefetch.report);
+  });
+}
+
+/**
+ * @brief Discards any collection work done ahead of an export
+ */
+void JsonExportUtils::ClearPrefetch()
+{
+  GetPrefetchState().reset();
+}
+
+/**
+ * @brief Starts an export that runs on the API thread in short slices of idle time, continuing from any collection
+ * work done ahead of it for the same settings. Each call to RunExportJobSlice does a slice of the export, so the
+ * dialog stays responsive and can cancel it. Any export job already running is replaced.
+ * @param[in] settingsData Settings for determining what element data to extract
+ * @param[in] progressListener Listener to report progress to, or null if progress is not needed
+ */
+void JsonExportUtils::StartExportJob(const JsonExportSettingsData& settingsData, ExportProgressListener* progressListener)
+{
+  if (settingsData.recordTrace)
+    TraceRecorder::Start();
+
+  std::unique_ptr<ExportJob>& job = GetExportJob();
+  job = std::make_unique<ExportJob>(settingsData, progressListener);
+  {
+    job->progress.BeginPhase(ExportPhase::TypeResolution, 0);
+    ExportReport::ScopedPhase phase(job->report, ExportPhase::TypeResolution);
+    job->plan = ExportPlan::GetSessionPlan(settingsData, job->isPlanReused);
+  }
+
+  // Take over the collection work done while the dialog was idle, however far it got, if it was done for the same
+  // collection settings
+  std::unique_ptr<PrefetchState> prefetch = std::move(GetPrefetchState());
+  if (prefetch != nullptr && prefetch->fingerprint == ExportPlan::GetCollectionFingerprint(settingsData))
+  {
+    job->report.AddCounts(prefetch->report);
+    job->report.AddCount(ExportCounter::PrefetchedElements, prefetch->collectedCount);
+    job->report.GetMemory().Allocate(MemoryCategory::ElementData, prefetch->headers.GetMemorySize());
+    job->report.GetMemory().Allocate(MemoryCategory::ElementData, prefetch->pending.elemGuids.size() * PendingElementBytes);
+    job->collection = std::move(prefetch);
+  }
+  else
+  {
+    job->collection = std::make_unique<PrefetchState>(settingsData);
+  }
+
+  const PrefetchState& collection = *job->collection;
+  if (collection.isListed)
+    job->progress.BeginPhase(ExportPhase::DefinitionFetch, collection.elemGuids.GetSize() - collection.collectedCount);
+  else
+    job->progress.BeginPhase(ExportPhase::GuidCollection, 0);
+}
+
+/**
+ * @brief Runs the export job for up to a short slice of time. Elements are listed, collected and have their values
+ * fetched in groups sized to fit the time left in the slice, and batched exports serialize and write each group as
+ * they go. Once every value is fetched, the output is serialized, written and uploaded on a worker thread, which
+ * later slices check on without waiting for it. The job is then finished, showing its results and writing the
+ * report. A cancelled job stops fetching at its next slice, and its worker at the next check of the token.
+ * @returns True if the job is still running
+ */
+bool JsonExportUtils::RunExportJobSlice()
+{
+  std::unique_ptr<ExportJob>& job = GetExportJob();
+  if (job == nullptr)
+    return false;
+
+  ExportPlan& plan = *job->plan;
+  if (job->outputTask.valid())
+  {
+    // Hand on the worker's progress, and finish the job once its output is done
+    job->progressRelay.Forward();
+    if (job->outputTask.wait_for(std::chrono::milliseconds::zero()) != std::future_status::ready)
+      return true;
+    job->outputTask.get();
+  }
+  else
+  {
+    TraceRecorder::ScopedSpan sliceSpan("Export slice", "export");
+    ExportJob& runningJob = *job;
+    bool isMoreWork = job->slicer.RunSlice([&plan, &runningJob](USize groupSize)
+    {
+      return !runningJob.cancellationToken.IsCancelled() && RunExportJobStep(plan, runningJob, groupSize);
+    });
+
+    job->progressRelay.Forward();
+    if (!job->cancellationToken.IsCancelled() && (isMoreWork || StartExportOutput(plan, *job)))
+      return true;
+  }
+
+  FinishExportJob(plan, *job);
+  job.reset();
+  return false;
+}
+
+/**
+ * @brief Cancels the running export job and finishes it at once, without showing anything, for when the dialog
+ * running it closes. Output being written on a worker thread is waited for until it sees the cancellation. The
+ * report of the cancelled export is still written.
+ */
+void JsonExportUtils::AbandonExportJob()
+{
+  std::unique_ptr<ExportJob>& job = GetExportJob();
+  if (job == nullptr)
+    return;
+
+  job->cancellationToken.Cancel();
+  if (job->outputTask.valid())
+    job->outputTask.wait();
+
+  job->report.Finish();
+  job->cancellationToken.MarkStopped();
+  RemoveOutputFile(*job);
+  TraceRecorder::Stop();
+  WriteReportFiles(*job->plan, job->report, job->cancellationToken, job->isIncremental, job->isPlanReused);
+  job.reset();
+}
+
+/**
+ * @brief Cancels the running export job, which is finished by the next call to RunExportJobSlice
+ */
+void JsonExportUtils::CancelExportJob()
+{
+  std::unique_ptr<ExportJob>& job = GetExportJob();
+  if (job != nullptr)
+    job->cancellationToken.Cancel();
+}
+
+/**
+ * @brief Determines if an export job has been started and not yet finished
+ * @returns True if an export job is running
+ */
+bool JsonExportUtils::IsExportJobRunning()
+{
+  return GetExportJob() != nullptr;
 }
 
 /**
@@ -86,38 +388,576 @@ bool JsonExportUtils::IsAnyElementsSelected()
   return error == NoError && selectionInfo.sel_nElem > 0;
 }
 
-void JsonExportUtils::BuildElementData(const GS::Array<API_Guid>& elemGuids, const GS::Array<API_PropertyDefinitionFilter>& filters, GS::Array<ElementData>& data)
+JsonExportUtils::PrefetchState::PrefetchState(const JsonExportSettingsData& settingsData) :
+  fingerprint(ExportPlan::GetCollectionFingerprint(settingsData)),
+  elementFilter(settingsData),
+  listedCount(0),
+  isListed(false),
+  collectedCount(0),
+  slicer(PrefetchSliceDuration, PrefetchGroupSize)
+{
+  if (settingsData.selectedOnly)
+    GetSelectedElements(selectedGuids);
+}
+
+std::unique_ptr<JsonExportUtils::PrefetchState>& JsonExportUtils::GetPrefetchState()
+{
+  static std::unique_ptr<PrefetchState> prefetchState;
+  return prefetchState;
+}
+
+bool JsonExportUtils::RunPrefetchStep(const ExportPlan& plan, const JsonExportSettingsData& settingsData, PrefetchState& state, USize groupSize, ExportReport& report)
+{
+  CancellationToken cancellationToken;
+  ExportProgressReporter progress(nullptr);
+  const GS::Array<API_ElemTypeID>& elemTypes = plan.GetElemTypes();
+
+  // List the guids of an element type, or filter a group of selected elements by type, keeping their headers
+  if (!state.isListed)
+  {
+    if (settingsData.selectedOnly)
+    {
+      GS::Array<API_Guid> groupGuids;
+      for (USize i = state.listedCount; i < std::min(state.listedCount + groupSize, state.selectedGuids.GetSize()); ++i)
+        groupGuids.Push(state.selectedGuids[i]);
+
+      FilterElementsByType(elemTypes, groupGuids, state.headers, report, state.elemGuids);
+      state.listedCount += groupGuids.GetSize();
+      state.isListed = state.listedCount >= state.selectedGuids.GetSize();
+    }
+    else
+    {
+      if (state.listedCount < elemTypes.GetSize())
+        GetElementsFromTypes({ elemTypes[state.listedCount++] }, cancellationToken, state.elemGuids);
+      state.isListed = state.listedCount >= elemTypes.GetSize();
+    }
+    return true;
+  }
+
+  // Collect the next group of listed elements
+  GS::Array<API_Guid> groupGuids;
+  for (USize i = state.collectedCount; i < std::min(state.collectedCount + groupSize, state.elemGuids.GetSize()); ++i)
+    groupGuids.Push(state.elemGuids[i]);
+
+  CollectElements(groupGuids, settingsData.propertyDefinitionFilters, plan.GetAllowList(), state.elementFilter, state.headers, report, cancellationToken, progress, state.pending);
+  state.collectedCount += groupGuids.GetSize();
+  return state.collectedCount < state.elemGuids.GetSize();
+}
+
+JsonExportUtils::ExportJob::ExportJob(const JsonExportSettingsData& settingsData, ExportProgressListener* progressListener) :
+  settings(settingsData),
+  isPlanReused(false),
+  progressRelay(progressListener),
+  progress(progressListener != nullptr ? &progressRelay : nullptr),
+  isCollected(false),
+  isIncremental(false),
+  propertyCache(nullptr),
+  fetchedCount(0),
+  incrementalWriter(JsonIndentWidth),
+  isOutputStarted(false),
+  slicer(ExportJobSliceDuration, ExportJobGroupSize)
+{
+}
+
+std::unique_ptr<JsonExportUtils::ExportJob>& JsonExportUtils::GetExportJob()
+{
+  static std::unique_ptr<ExportJob> exportJob;
+  return exportJob;
+}
+
+bool JsonExportUtils::RunExportJobStep(ExportPlan& plan, ExportJob& job, USize groupSize)
+{
+  PrefetchState& collection = *job.collection;
+  const PendingElements& pending = collection.pending;
+
+  // List element guids, then collect the listed elements a group at a time
+  if (!collection.isListed)
+  {
+    ExportReport::ScopedPhase phase(job.report, ExportPhase::GuidCollection);
+    RunPrefetchStep(plan, job.settings, collection, groupSize, job.report);
+    if (collection.isListed)
+      job.progress.BeginPhase(ExportPhase::DefinitionFetch, collection.elemGuids.GetSize());
+    return true;
+  }
+
+  if (!job.isCollected)
+  {
+    USize collectedCount = collection.collectedCount;
+    bool isMoreToCollect = RunPrefetchStep(plan, job.settings, collection, groupSize, job.report);
+    job.progress.Advance(collection.collectedCount - collectedCount);
+    if (isMoreToCollect)
+      return true;
+
+    job.isCollected = true;
+    AddToPlanEstimates(pending, plan);
+    job.isIncremental = IsIncrementalExport(plan, pending);
+    job.propertyCache = PreparePropertyCache(plan);
+
+    // Batched exports fetch, serialize and write a group at a time in key order, to the export file or to a
+    // temporary file that is uploaded afterwards. The local server needs every element held at once, which would
+    // exceed the budget, so a batched export that is only served has nothing to fetch or write.
+    if (job.isIncremental)
+    {
+      if (!job.settings.exportToFile && !job.settings.exportToUrl)
+        return false;
+
+      SortElementsInKeyOrder(pending, job.elemIndices);
+      job.outputFilePath = job.settings.exportToFile ? plan.GetFilePath() : GetTemporaryFilePath();
+      job.incrementalWriter.SetRealDecimalPlaces(job.settings.realDecimalPlaces);
+      JsonParser::BeginIncremental(job.incrementalWriter);
+      job.progress.BeginPhase(ExportPhase::ValueFetch, job.elemIndices.size());
+      return true;
+    }
+
+    job.elemIndices.resize(pending.elemGuids.size());
+    std::iota(job.elemIndices.begin(), job.elemIndices.end(), 0);
+    AddLayersToStore(pending, job.store);
+    job.progress.BeginPhase(ExportPhase::ValueFetch, job.elemIndices.size());
+    return !job.elemIndices.empty();
+  }
+
+  // Fetch the values of the next group of elements, in the same order as a full export
+  size_t fetchEnd = std::min(job.fetchedCount + groupSize, job.elemIndices.size());
+  std::vector<size_t> groupIndices(job.elemIndices.begin() + job.fetchedCount, job.elemIndices.begin() + fetchEnd);
+  if (job.isIncremental)
+    return RunIncrementalStep(plan, job, groupIndices);
+
+  FetchPropertyValues(pending, groupIndices, job.settings.propertyBatchSize, job.propertyCache, FailingDefinitionCache::GetSessionCache(), job.report, job.cancellationToken, job.progress, job.store);
+  job.fetchedCount = fetchEnd;
+  return job.fetchedCount < job.elemIndices.size();
+}
+
+void JsonExportUtils::FinishExportJob(const ExportPlan& plan, ExportJob& job)
+{
+  const JsonExportSettingsData& settingsData = plan.GetSettings();
+  job.report.Finish();
+  job.cancellationToken.MarkStopped();
+  RemoveOutputFile(job);
+  TraceRecorder::Stop();
+
+  // Show the outcome of each output, now that no more work is left to hold up
+  if (job.cancellationToken.IsCancelled())
+  {
+    DGAlert(DG_INFORMATION, "Export", "", "Export was cancelled, no data has been exported.", "OK");
+  }
+  else
+  {
+    if (settingsData.exportToFile)
+      ShowFileExportResult(settingsData.filePath, job.output.isWritten, job.output.fileErrorStr, job.report);
+    if (settingsData.exportToUrl)
+      ShowUrlExportResult(settingsData.baseUrl, job.output.isUploaded, job.output.urlErrorStr, job.report);
+    if (settingsData.serveLocally && job.isIncremental)
+      ShowServerResult(settingsData.serverPort, 0, false, ServerOverBudgetError, job.report);
+    else if (job.output.snapshot != nullptr)
+      PublishSnapshot(plan, job.output.snapshot, job.report);
+  }
+
+  WriteReportFiles(plan, job.report, job.cancellationToken, job.isIncremental, job.isPlanReused);
+}
+
+bool JsonExportUtils::IsIncrementalExport(const ExportPlan& plan, const PendingElements& pending)
+{
+  // Export elements in batches if holding all of their data at once would exceed the memory budget. The columnar
+  // format needs every element to build its dictionaries, so it is always exported in one go.
+  return !plan.IsArrowFormat() && EstimateExportSize(pending) > plan.GetMemoryBudgetBytes();
+}
+
+PropertyCache* JsonExportUtils::PreparePropertyCache(const ExportPlan& plan)
+{
+  // Reuse the values of elements that are unchanged since a previous export, holding up to half of the budget
+  const JsonExportSettingsData& settingsData = plan.GetSettings();
+  PropertyCache& sessionCache = PropertyCache::GetSessionCache();
+  if (!settingsData.reuseUnchangedValues)
+    sessionCache.Clear();
+  sessionCache.SetMaxMemorySize(plan.GetMemoryBudgetBytes() / 2);
+  return settingsData.reuseUnchangedValues ? &sessionCache : nullptr;
+}
+
+bool JsonExportUtils::RunIncrementalStep(const ExportPlan& plan, ExportJob& job, const std::vector<size_t>& groupIndices)
+{
+  const PendingElements& pending = job.collection->pending;
+
+  // Fetch and serialize the group, then release its property values
+  ElementStore groupStore;
+  AddLayersToStore(pending, groupStore);
+  if (!FetchPropertyValues(pending, groupIndices, job.settings.propertyBatchSize, job.propertyCache, FailingDefinitionCache::GetSessionCache(), job.report, job.cancellationToken, job.progress, groupStore))
+    return false;
+
+  ResolveElemTypeNames(groupStore, job.elemTypeNames);
+  bool isParsed = JsonParser::ParseIncremental(groupStore, job.elemTypeNames, job.incrementalState, job.report, job.cancellationToken, job.incrementalWriter);
+  job.report.GetMemory().Release(MemoryCategory::PropertyValues, groupStore.GetMemorySize());
+  if (!isParsed)
+    return false;
+  job.fetchedCount += groupIndices.size();
+
+  // Write the output a chunk at a time, closing the json and ending the file with a new line after the last group,
+  // as for exports written in one go
+  bool isLastGroup = job.fetchedCount >= job.elemIndices.size();
+  if (!isLastGroup && job.incrementalWriter.GetBuffer().size() < IncrementalChunkBytes)
+    return true;
+
+  if (isLastGroup)
+    JsonParser::EndIncremental(job.incrementalState, job.incrementalWriter);
+  std::string chunk = job.incrementalWriter.FlushBuffer();
+  if (isLastGroup)
+    chunk += '\n';
+
+  bool isChunkWritten = ExportChunkToFile(chunk, job.outputFilePath, job.isOutputStarted, job.report, job.cancellationToken, job.progress, job.output.fileErrorStr);
+  job.isOutputStarted = true;
+  if (!isChunkWritten)
+  {
+    // A file that could not be written cannot be uploaded either
+    job.output.urlErrorStr = job.output.fileErrorStr;
+    return false;
+  }
+
+  job.output.isWritten = isLastGroup;
+  return !isLastGroup;
+}
+
+bool JsonExportUtils::StartExportOutput(const ExportPlan& plan, ExportJob& job)
+{
+  // A batched export has already been written, leaving only the written file to upload
+  if (job.isIncremental)
+  {
+    if (!plan.GetSettings().exportToUrl || !job.output.isWritten)
+      return false;
+
+    job.outputTask = std::async(std::launch::async, [&plan, &job]()
+    {
+      UploadExportFile(plan, job.outputFilePath, job.report, job.cancellationToken, job.progress, job.output);
+    });
+    return true;
+  }
+
+  // Resolve type names here, as neither the worker nor the server's threads can call the API
+  ResolveElemTypeNames(job.store, job.elemTypeNames);
+  job.outputTask = std::async(std::launch::async, [&plan, &job]()
+  {
+    WriteExportOutput(plan, job.store, job.elemTypeNames, job.report, job.cancellationToken, job.progress, job.output);
+  });
+  return true;
+}
+
+void JsonExportUtils::WriteExportOutput(const ExportPlan& plan, ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ExportOutput& output)
+{
+  const JsonExportSettingsData& settingsData = plan.GetSettings();
+
+  // Only exports to file or url are serialized, the local server writes elements as they are requested
+  if (settingsData.exportToFile || settingsData.exportToUrl)
+  {
+    std::string exportData;
+    if (!SerializeStore(plan, store, elemTypeNames, report, cancellationToken, progress, exportData))
+      return;
+
+    // Export data to file and/or url, doing both at once when both are requested
+    const char* contentType = plan.GetContentType();
+    if (settingsData.exportToFile && settingsData.exportToUrl)
+      RunExportToFileAndUrl(settingsData.filePath, settingsData.baseUrl, exportData, contentType, report, cancellationToken, progress, output);
+    else if (settingsData.exportToFile)
+      RunExportToFile(settingsData.filePath, exportData, report, cancellationToken, progress, output);
+    else
+      RunExportToUrl(settingsData.baseUrl, exportData, contentType, report, cancellationToken, progress, output);
+  }
+
+  // Index the elements for the local server here as well, handing the store over to the snapshot
+  if (settingsData.serveLocally && !cancellationToken.IsCancelled())
+  {
+    TraceRecorder::ScopedSpan span("Build snapshot", "serve");
+    output.snapshot = std::make_shared<const ElementSnapshot>(std::move(store), elemTypeNames, settingsData.realDecimalPlaces);
+  }
+}
+
+bool JsonExportUtils::SerializeStore(const ExportPlan& plan, const ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, std::string& exportData)
+{
+  // Serialize data to JSON or the columnar Arrow format
+  progress.BeginPhase(ExportPhase::Serialize, store.GetElementCount());
+  if (plan.IsArrowFormat())
+  {
+    ArrowSerializer::Serialize(store, elemTypeNames, report, exportData);
+    if (cancellationToken.IsCancelled())
+      return false;
+  }
+  else
+  {
+    JsonWriter writer(JsonIndentWidth);
+    writer.SetRealDecimalPlaces(plan.GetSettings().realDecimalPlaces);
+    if (!JsonParser::Parse(store, elemTypeNames, report, cancellationToken, writer))
+      return false;
+    exportData = writer.TakeBuffer();
+    exportData += '\n';
+  }
+  progress.Advance(store.GetElementCount());
+  report.AddCount(ExportCounter::BytesSerialized, exportData.size());
+
+  // Json ends with a new line, so the bytes hashed are those written to file and uploaded
+  report.HashOutput(exportData);
+  report.GetMemory().Allocate(MemoryCategory::SerializedData, exportData.size());
+  return true;
+}
+
+void JsonExportUtils::UploadExportFile(const ExportPlan& plan, const std::string& filePath, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ExportOutput& output)
 {
+  UInt64 fileBytes = report.GetCount(ExportCounter::BytesWritten);
+  {
+    progress.BeginPhase(ExportPhase::Upload, fileBytes);
+    ExportReport::ScopedPhase phase(report, ExportPhase::Upload);
+    output.isUploaded = DataExporter::ExportFileToUrl(filePath, plan.GetSettings().baseUrl.ToCStr().Get(), plan.GetContentType(), cancellationToken, output.urlErrorStr);
+  }
+
+  if (output.isUploaded)
+  {
+    report.AddCount(ExportCounter::BytesUploaded, fileBytes);
+    progress.Advance(fileBytes);
+    progress.AddBytesUploaded(fileBytes);
+  }
+}
+
+void JsonExportUtils::RemoveOutputFile(const ExportJob& job)
+{
+  // Batched exports leave no partly written file behind when cancelled, and the temporary file of an upload is
+  // always removed
+  if (job.outputFilePath.empty() || (job.settings.exportToFile && !job.cancellationToken.IsCancelled()))
+    return;
+
+  std::error_code errorCode;
+  std::filesystem::remove(job.outputFilePath, errorCode);
+}
+
+void JsonExportUtils::PublishSnapshot(const ExportPlan& plan, const std::shared_ptr<const ElementSnapshot>& snapshot, ExportReport& report)
+{
+  const JsonExportSettingsData& settingsData = plan.GetSettings();
+  QueryServer& server = QueryServer::GetSessionServer();
+  std::string errorStr;
+  bool isServed = server.Start(settingsData.serverPort, errorStr);
+  if (isServed)
+  {
+    // Keep the add-on loaded once the dialog closes, so that the server keeps running
+    ACAPI_KeepInMemory(true);
+    server.Publish(snapshot);
+  }
+  ShowServerResult(settingsData.serverPort, snapshot->GetElementCount(), isServed, errorStr, report);
+}
+
+void JsonExportUtils::ResolveElemTypeNames(const ElementStore& store, std::vector<GS::UniString>& elemTypeNames)
+{
+  // Resolve the names of types not seen before, so that serializing and serving elements need not call the API
+  for (UInt32 i = 0; i < store.GetElementCount(); ++i)
+  {
+    size_t elemTypeIndex = static_cast<size_t>(store.GetElementTypeId(i));
+    if (elemTypeIndex >= elemTypeNames.size())
+      elemTypeNames.resize(elemTypeIndex + 1);
+    if (elemTypeNames[elemTypeIndex].IsEmpty())
+      ACAPI_Element_GetElemTypeName(store.GetElementTypeId(i), elemTypeNames[elemTypeIndex]);
+  }
+}
+
+void JsonExportUtils::CollectElements(const GS::Array<API_Guid>& elemGuids, const GS::Array<API_PropertyDefinitionFilter>& filters, const PropertyAllowList& allowList, ElementFilter& elementFilter, ElementHeaderCache& headers, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, PendingElements& pending)
+{
+  progress.BeginPhase(ExportPhase::DefinitionFetch, elemGuids.GetSize());
+
+  // Resolve the property definitions of each element, sharing a single definition set between elements with identical definitions
   for (const API_Guid& elemGuid : elemGuids)
   {
-    // Get header data
+    if (cancellationToken.IsCancelled())
+      return;
+    progress.Advance();
+
+    // Get header data and layer name, discarding elements filtered out by their storey, layer or classification
+    // before their property definitions are requested
     API_Elem_Head header;
-    BNZeroMemory(&header, sizeof(API_Elem_Head));
-    header.guid = elemGuid;
+    UInt32 layerNameIndex;
+    {
+      ExportReport::ScopedPhase phase(report, ExportPhase::HeaderFetch);
+      if (!headers.TakeHeader(elemGuid, header, report))
+      {
+        report.AddCount(ExportCounter::Failures);
+        continue;
+      }
+      if (!elementFilter.IsStoreyIncluded(header))
+      {
+        report.AddCount(ExportCounter::FilteredElements);
+        continue;
+      }
+      layerNameIndex = GetLayerNameIndex(header.layer, pending, report);
+      if (!elementFilter.IsLayerIncluded(pending.layerNames[layerNameIndex].isHidden))
+      {
+        report.AddCount(ExportCounter::FilteredElements);
+        continue;
+      }
+    }
+    {
+      ExportReport::ScopedPhase phase(report, ExportPhase::ClassificationFetch);
+      if (!elementFilter.IsClassificationIncluded(elemGuid, report))
+      {
+        report.AddCount(ExportCounter::FilteredElements);
+        continue;
+      }
+    }
 
-    if (ACAPI_Element_GetHeader(&header) != NoError)
-      continue;
+    // Get property definitions
+    GS::Array<API_Guid> definitionGuids;
+    UInt64 definitionsHash;
+    {
+      ExportReport::ScopedPhase phase(report, ExportPhase::DefinitionFetch);
+      if (!GetElementPropertyDefinitions(elemGuid, filters, allowList, definitionGuids, definitionsHash))
+        continue;
+    }
+
+    // Find or add the set matching the element's definitions
+    std::string setKey(reinterpret_cast<const char*>(definitionGuids.Begin()), definitionGuids.GetSize() * sizeof(API_Guid));
+    auto setIt = pending.definitionSetKeys.find(setKey);
+    if (setIt == pending.definitionSetKeys.end())
+    {
+      setIt = pending.definitionSetKeys.emplace(setKey, pending.definitionSets.size()).first;
+      pending.definitionSets.push_back(definitionGuids);
+      pending.definitionSetHashes.push_back(definitionsHash);
+    }
+    pending.definitionSetIndices.push_back(setIt->second);
+
+    pending.elemGuids.push_back(elemGuid);
+    pending.elemTypeIds.push_back(header.type.typeID);
+    pending.layerIndices.push_back(layerNameIndex);
+    pending.modiStamps.push_back(header.modiStamp);
+    report.GetMemory().Allocate(MemoryCategory::ElementData, PendingElementBytes);
+  }
+}
+
+bool JsonExportUtils::FetchPropertyValues(const PendingElements& pending, const std::vector<size_t>& elemIndices, UInt32 batchSize, PropertyCache* propertyCache, FailingDefinitionCache& failingDefinitions, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ElementStore& store)
+{
+  ExportReport::ScopedPhase phase(report, ExportPhase::ValueFetch);
+
+  // Fetch property values in batches, adding elements to the store in the order given
+  batchSize = std::max<UInt32>(batchSize, 1);
+  for (size_t batchStart = 0; batchStart < elemIndices.size(); batchStart += batchSize)
+  {
+    if (cancellationToken.IsCancelled())
+      return false;
+
+    size_t batchEnd = std::min<size_t>(batchStart + batchSize, elemIndices.size());
+    TraceRecorder::ScopedSpan batchSpan("Property value batch", "fetch");
+    batchSpan.SetArg("elements", static_cast<Int64>(batchEnd - batchStart));
+
+    UInt64 storeSize = store.GetMemorySize();
+    FetchPropertyValueBatch(pending, elemIndices, batchStart, batchEnd, propertyCache, failingDefinitions, report, store);
+    report.GetMemory().Allocate(MemoryCategory::PropertyValues, store.GetMemorySize() - storeSize);
+    progress.Advance(batchEnd - batchStart);
+  }
+  return true;
+}
+
+void JsonExportUtils::AddToPlanEstimates(const PendingElements& pending, ExportPlan& plan)
+{
+  // Record the collected elements and their requested properties, estimating the next export with the same plan
+  plan.BeginEstimates();
+  for (size_t i = 0; i < pending.elemGuids.size(); ++i)
+    plan.AddToEstimates(pending.elemTypeIds[i], pending.definitionSets[pending.definitionSetIndices[i]].GetSize());
+}
+
+void JsonExportUtils::AddLayersToStore(const PendingElements& pending, ElementStore& store)
+{
+  // Layers are added in the same order, so the store shares the pending elements' layer indices
+  for (const LayerName& layerName : pending.layerNames)
+    store.AddLayer(layerName.name);
+}
+
+void JsonExportUtils::SortElementsInKeyOrder(const PendingElements& pending, std::vector<size_t>& order)
+{
+  std::vector<ElementSortKey> sortKeys;
+  sortKeys.reserve(pending.elemGuids.size());
+
+  // Obtain the UTF-8 names that the json parser orders elements by
+  std::vector<std::string> layerNames;
+  for (const LayerName& layerName : pending.layerNames)
+    layerNames.push_back(layerName.name.ToCStr(0, MaxUSize, CC_UTF8).Get());
+
+  std::vector<std::string> elemTypeNames;
+  for (size_t i = 0; i < pending.elemGuids.size(); ++i)
+  {
+    API_ElemTypeID elemTypeId = pending.elemTypeIds[i];
+    size_t typeIndex = static_cast<size_t>(elemTypeId);
+    if (typeIndex >= elemTypeNames.size())
+      elemTypeNames.resize(typeIndex + 1);
+    if (elemTypeNames[typeIndex].empty())
+    {
+      GS::UniString elemTypeName;
+      ACAPI_Element_GetElemTypeName(elemTypeId, elemTypeName);
+      elemTypeNames[typeIndex] = elemTypeName.ToCStr(0, MaxUSize, CC_UTF8).Get();
+    }
+
+    std::string elemGuid;
+    GuidFormatter::Append(elemGuid, pending.elemGuids[i]);
+    sortKeys.push_back({ layerNames[pending.layerIndices[i]], elemTypeNames[typeIndex], std::move(elemGuid), i });
+  }
+
+  std::stable_sort(sortKeys.begin(), sortKeys.end(), [](const ElementSortKey& a, const ElementSortKey& b)
+  {
+    if (a.layerName != b.layerName)
+      return a.layerName < b.layerName;
+    if (a.elemTypeName != b.elemTypeName)
+      return a.elemTypeName < b.elemTypeName;
+    return a.elemGuid < b.elemGuid;
+  });
 
-    // Get properies data
-    GS::Array<API_Property> properties;
-    if (!GetElementProperties(elemGuid, filters, properties))
+  // Skip elements that are repeated later, the last occurrence is kept
+  for (size_t i = 0; i < sortKeys.size(); ++i)
+  {
+    if (i + 1 < sortKeys.size() && sortKeys[i + 1].elemGuid == sortKeys[i].elemGuid)
       continue;
+    order.push_back(sortKeys[i].index);
+  }
+}
 
-    // Get layer name
-    GS::UniString layerName;
-    API_Attribute attrib;
-    BNZeroMemory(&attrib, sizeof(API_Attribute));
+UInt64 JsonExportUtils::EstimateElementSize(const PendingElements& pending, size_t elemIndex)
+{
+  UInt64 propertyCount = pending.definitionSets[pending.definitionSetIndices[elemIndex]].GetSize();
+  return PendingElementBytes + ElementStore::EstimateMemorySize(1, propertyCount, propertyCount * EstimatedPropertyValueBytes);
+}
 
-    attrib.header.typeID = API_LayerID;
-    attrib.header.index = header.layer;
-    bool layerAttribFound = ACAPI_Attribute_Get(&attrib) == NoError;
-    layerName = layerAttribFound ? attrib.header.name : "UNKNOWN LAYER";
+UInt64 JsonExportUtils::EstimateExportSize(const PendingElements& pending)
+{
+  UInt64 size = 0;
+  for (size_t i = 0; i < pending.elemGuids.size(); ++i)
+    size += EstimateElementSize(pending, i);
+  return size;
+}
 
-    data.PushNew(elemGuid, header.type.typeID, layerName, properties);
+UInt32 JsonExportUtils::GetLayerNameIndex(const API_AttributeIndex& layerIndex, PendingElements& pending, ExportReport& report)
+{
+  // Layers whose names were obtained before are found by their attribute index
+  auto it = pending.layerNameIndices.find(GetAttributeIndexKey(layerIndex));
+  if (it != pending.layerNameIndices.end())
+  {
+    report.AddCount(ExportCounter::CacheHits);
+    return it->second;
   }
+  report.AddCount(ExportCounter::CacheMisses);
+
+  API_Attribute attrib;
+  BNZeroMemory(&attrib, sizeof(API_Attribute));
+
+  attrib.header.typeID = API_LayerID;
+  attrib.header.index = layerIndex;
+  bool layerAttribFound = ACAPI_Attribute_Get(&attrib) == NoError;
+  GS::UniString name = layerAttribFound ? attrib.header.name : "UNKNOWN LAYER";
+  bool isHidden = layerAttribFound && (attrib.header.flags & APILay_Hidden) != 0;
+
+  UInt32 layerNameIndex = static_cast<UInt32>(pending.layerNames.size());
+  pending.layerNames.push_back({ layerIndex, name, isHidden });
+  pending.layerNameIndices.emplace(GetAttributeIndexKey(layerIndex), layerNameIndex);
+  return layerNameIndex;
+}
+
+Int32 JsonExportUtils::GetAttributeIndexKey(const API_AttributeIndex& attributeIndex)
+{
+#ifdef ServerMainVers_2700
+  return attributeIndex.ToInt32_Deprecated();
+#else
+  return attributeIndex;
+#endif
 }
 
-bool JsonExportUtils::GetElementProperties(const API_Guid& elemGuid, const GS::Array<API_PropertyDefinitionFilter>& filters, GS::Array<API_Property>& properties)
+bool JsonExportUtils::GetElementPropertyDefinitions(const API_Guid& elemGuid, const GS::Array<API_PropertyDefinitionFilter>& filters, const PropertyAllowList& allowList, GS::Array<API_Guid>& definitionGuids, UInt64& definitionsHash)
 {
   // Get all property definitions for the given element and filters
   GS::Array<API_PropertyDefinition> propertyDefinitions;
@@ -127,39 +967,101 @@ bool JsonExportUtils::GetElementProperties(const API_Guid& elemGuid, const GS::A
       continue;
   }
 
-  // Try obtaining property values from the given properties
-  if (ACAPI_Element_GetPropertyValues(elemGuid, propertyDefinitions, properties) != NoError || properties.IsEmpty())
-    return false;
+  // Only request values for definitions in the allow-list. The hash covers everything the store keeps of each
+  // definition, so cached values are not reused once a definition is renamed or changes type.
+  ContentHash hash;
+  for (const API_PropertyDefinition& definition : propertyDefinitions)
+  {
+    if (!allowList.Contains(definition))
+      continue;
 
-  return true;
+    definitionGuids.Push(definition.guid);
+    hash.Append(&definition.guid, sizeof(API_Guid));
+    hash.Append(&definition.collectionType, sizeof(API_PropertyCollectionType));
+    hash.Append(&definition.valueType, sizeof(API_VariantType));
+    hash.Append(definition.name.ToUStr().Get(), definition.name.GetLength() * sizeof(GS::UniChar::Layout));
+  }
+
+  definitionsHash = hash.GetValue();
+  return !definitionGuids.IsEmpty();
+}
+
+void JsonExportUtils::FetchPropertyValueBatch(const PendingElements& pending, const std::vector<size_t>& elemIndices, size_t batchStart, size_t batchEnd, PropertyCache* propertyCache, FailingDefinitionCache& failingDefinitions, ExportReport& report, ElementStore& store)
+{
+  // Request values by definition guid, which avoids passing full definitions to the API for every element. Values
+  // are copied into the store straight away, so only one element's API properties are held at a time.
+  GS::Array<API_Property> properties;
+  for (size_t i = batchStart; i < batchEnd; ++i)
+  {
+    size_t elemIndex = elemIndices[i];
+    size_t definitionSetIndex = pending.definitionSetIndices[elemIndex];
+    const GS::Array<API_Guid>& definitionGuids = pending.definitionSets[definitionSetIndex];
+
+    // Copy the values of unchanged elements from the cache
+    UInt64 modiStamp = pending.modiStamps[elemIndex];
+    UInt64 definitionsHash = pending.definitionSetHashes[definitionSetIndex];
+    if (propertyCache != nullptr)
+    {
+      if (propertyCache->CopyElement(pending.elemGuids[elemIndex], modiStamp, definitionsHash, pending.layerIndices[elemIndex], store))
+      {
+        UInt32 storeIndex = store.GetElementCount() - 1;
+        report.AddCount(ExportCounter::PropertyCacheHits);
+        report.AddCount(ExportCounter::Elements);
+        report.AddCount(ExportCounter::Properties, store.GetPropertyEnd(storeIndex) - store.GetFirstProperty(storeIndex));
+        continue;
+      }
+      report.AddCount(ExportCounter::PropertyCacheMisses);
+    }
+
+    if (!failingDefinitions.GetPropertyValues(pending.elemGuids[elemIndex], pending.elemTypeIds[elemIndex], definitionGuids, definitionsHash, report, properties))
+    {
+      report.AddCount(ExportCounter::Failures);
+      continue;
+    }
+
+    store.AddElement(pending.elemGuids[elemIndex], pending.elemTypeIds[elemIndex], pending.layerIndices[elemIndex], properties);
+    report.AddCount(ExportCounter::Elements);
+    report.AddCount(ExportCounter::Properties, properties.GetSize());
+
+    if (propertyCache != nullptr)
+      propertyCache->AddElement(modiStamp, definitionsHash, store, store.GetElementCount() - 1);
+  }
 }
 
-void JsonExportUtils::GetElementsFromTypes(const GS::Array<API_ElemTypeID>& elemTypes, GS::Array<API_Guid>& elemGuids)
+void JsonExportUtils::GetElementsFromTypes(const GS::Array<API_ElemTypeID>& elemTypes, CancellationToken& cancellationToken, GS::Array<API_Guid>& elemGuids)
 {
   // Extract element guids from each supplied element type
   for (API_ElemTypeID elemTypeId : elemTypes)
   {
+    if (cancellationToken.IsCancelled())
+      return;
+
     GS::Array<API_Guid> elemTypeGuids;
-    if (ACAPI_Element_GetElemList(elemTypeId, &elemGuids) == NoError)
-      elemTypeGuids.Append(elemGuids);
+    if (ACAPI_Element_GetElemList(elemTypeId, &elemTypeGuids) == NoError)
+      elemGuids.Append(elemTypeGuids);
   }
 }
 
-void JsonExportUtils::FilterElementsByType(const GS::Array<API_ElemTypeID>& elemTypes, const GS::Array<API_Guid>& inputElemGuids, GS::Array<API_Guid>& outputGuids)
+void JsonExportUtils::FilterElementsByType(const GS::Array<API_ElemTypeID>& elemTypes, const GS::Array<API_Guid>& inputElemGuids, ElementHeaderCache& headers, ExportReport& report, GS::Array<API_Guid>& outputGuids)
 {
+  // Mark the filtered types in a bitset, so each element's type is checked in constant time
+  std::bitset<API_LastElemType + 1> isFilteredType;
+  for (API_ElemTypeID elemTypeId : elemTypes)
+    isFilteredType.set(static_cast<size_t>(elemTypeId));
+
   for (const API_Guid& inputGuid : inputElemGuids)
   {
-    // Get header data
+    // Get header data, which is kept for when the element is collected
     API_Elem_Head header;
-    BNZeroMemory(&header, sizeof(API_Elem_Head));
-    header.guid = inputGuid;
-
-    if (ACAPI_Element_GetHeader(&header) != NoError)
+    if (!headers.GetHeader(inputGuid, header, report))
       continue;
 
     // Add elements whose type is contained in the type filters
-    if (elemTypes.Contains(header.type.typeID))
+    size_t typeIndex = static_cast<size_t>(header.type.typeID);
+    if (typeIndex < isFilteredType.size() && isFilteredType.test(typeIndex))
       outputGuids.Push(inputGuid);
+    else
+      headers.ReleaseHeader(inputGuid, report);
   }
 }
 
@@ -172,6 +1074,7 @@ void JsonExportUtils::GetSelectedElements(GS::Array<API_Guid>& elemGuids)
     return;
 
   // Obtain element guids for each neig
+  GS::HashSet<GS::Guid> addedGuids;
   for (const API_Neig& neig : selNeigs)
   {
     API_Guid elemGuid;
@@ -179,62 +1082,205 @@ void JsonExportUtils::GetSelectedElements(GS::Array<API_Guid>& elemGuids)
       continue;
 
     // Ignore duplicates
-    if (!elemGuids.Contains(elemGuid))
+    if (addedGuids.Add(APIGuid2GSGuid(elemGuid)))
       elemGuids.Push(elemGuid);
   }
 }
 
-void JsonExportUtils::GetElementTypesFromNames(const GS::Array<GS::UniString>& elemTypeNames, GS::Array<API_ElemTypeID>& elemTypes)
+void JsonExportUtils::RunExportToFile(const GS::UniString& filePath, const std::string& exportData, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ExportOutput& output)
 {
-  // Iterate over all element types
-  for (int i = API_FirstElemType; i <= API_LastElemType; ++i)
+  // Write to file, leaving the outcome to be shown once the export finishes
+  std::string filePathStr = filePath.ToCStr();
   {
-    API_ElemTypeID elemTypeId = API_ElemTypeID(i);
-    API_ElemType elemType = elemTypeId;
+    progress.BeginPhase(ExportPhase::Write, exportData.size());
+    ExportReport::ScopedPhase phase(report, ExportPhase::Write);
+    output.isWritten = DataExporter::ExportToFile(exportData, filePathStr, cancellationToken, output.fileErrorStr);
+  }
 
-    // Skip if no elements could be found for this element type
-    GS::Array<API_Guid> elemGuids;
-    if (ACAPI_Element_GetElemList(elemType, &elemGuids) != NoError || elemGuids.IsEmpty())
-      continue;
+  if (output.isWritten)
+  {
+    report.AddCount(ExportCounter::BytesWritten, exportData.size());
+    progress.Advance(exportData.size());
+    progress.AddBytesWritten(exportData.size());
+  }
+}
 
-    // Obtain name for the given element type
-    GS::UniString elemName;
-    if (ACAPI_Element_GetElemTypeName(elemType, elemName) != NoError)
-      continue;
+void JsonExportUtils::RunExportToUrl(const GS::UniString& baseUrl, const std::string& exportData, const std::string& contentType, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ExportOutput& output)
+{
+  // Export to url, leaving the outcome to be shown once the export finishes
+  std::string baseUrlStr = baseUrl.ToCStr();
+  {
+    progress.BeginPhase(ExportPhase::Upload, exportData.size());
+    ExportReport::ScopedPhase phase(report, ExportPhase::Upload);
+    output.isUploaded = DataExporter::ExportToUrl(exportData, baseUrlStr, contentType, cancellationToken, output.urlErrorStr);
+  }
 
-    if (elemTypeNames.Contains(elemName))
-      elemTypes.Push(elemTypeId);
+  if (output.isUploaded)
+  {
+    report.AddCount(ExportCounter::BytesUploaded, exportData.size());
+    progress.Advance(exportData.size());
+    progress.AddBytesUploaded(exportData.size());
   }
 }
 
-void JsonExportUtils::RunExportToFile(const GS::UniString& filePath, const json& exportJson)
+void JsonExportUtils::RunExportToFileAndUrl(const GS::UniString& filePath, const GS::UniString& baseUrl, const std::string& exportData, const std::string& contentType, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ExportOutput& output)
 {
-  // Write to file and alert user to success or failure
+  // Write the file from another worker thread while uploading the same buffer from this one. Both check the
+  // export's token, so cancelling stops them each at their next chunk.
   std::string filePathStr = filePath.ToCStr();
-  std::string errorStr;
-  if (DataExporter::ExportToFile(exportJson, filePathStr, JsonIndentWidth, errorStr))
+  double writeMilliseconds = 0.0;
+  std::future<bool> fileWrite = std::async(std::launch::async, [&exportData, &filePathStr, &cancellationToken, &output, &writeMilliseconds]()
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool isWritten = DataExporter::ExportToFile(exportData, filePathStr, cancellationToken, output.fileErrorStr);
+    writeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return isWritten;
+  });
+
+  progress.BeginPhase(ExportPhase::Upload, 2 * exportData.size());
   {
-    GS::UniString alertText = "Data sucessfully written to " + filePath;
+    ExportReport::ScopedPhase phase(report, ExportPhase::Upload);
+    output.isUploaded = DataExporter::ExportToUrl(exportData, baseUrl.ToCStr().Get(), contentType, cancellationToken, output.urlErrorStr);
+  }
+  if (output.isUploaded)
+  {
+    report.AddCount(ExportCounter::BytesUploaded, exportData.size());
+    progress.Advance(exportData.size());
+    progress.AddBytesUploaded(exportData.size());
+  }
+
+  output.isWritten = fileWrite.get();
+  report.AddPhaseDuration(ExportPhase::Write, writeMilliseconds);
+  if (output.isWritten)
+  {
+    report.AddCount(ExportCounter::BytesWritten, exportData.size());
+    progress.Advance(exportData.size());
+    progress.AddBytesWritten(exportData.size());
+  }
+}
+
+bool JsonExportUtils::ExportChunkToFile(const std::string& chunk, const std::string& filePath, bool append, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, std::string& errorStr)
+{
+  // Write a chunk of an incremental export, accounting for its memory only while it is held
+  report.AddCount(ExportCounter::BytesSerialized, chunk.size());
+  report.HashOutput(chunk);
+  report.GetMemory().Allocate(MemoryCategory::SerializedData, chunk.size());
+
+  bool isExported;
+  {
+    ExportReport::ScopedPhase phase(report, ExportPhase::Write);
+    isExported = DataExporter::ExportChunkToFile(chunk, filePath, append, cancellationToken, errorStr);
+  }
+
+  if (isExported)
+  {
+    report.AddCount(ExportCounter::BytesWritten, chunk.size());
+    progress.AddBytesWritten(chunk.size());
+  }
+
+  report.GetMemory().Release(MemoryCategory::SerializedData, chunk.size());
+  return isExported;
+}
+
+void JsonExportUtils::ShowFileExportResult(const GS::UniString& filePath, bool isExported, const std::string& errorStr, ExportReport& report)
+{
+  if (isExported)
+  {
+    GS::UniString alertText = "Data sucessfully written to " + filePath + "\n\n" + report.GetSummary();
     DGAlert(DG_INFORMATION, "Export to File", "", alertText, "OK");
   }
   else
   {
+    report.AddCount(ExportCounter::Failures);
     DGAlert(DG_ERROR, "Export to File", "", GS::UniString(errorStr), "OK");
   }
 }
 
-void JsonExportUtils::RunExportToUrl(const GS::UniString& baseUrl, const json& exportJson)
+void JsonExportUtils::ShowUrlExportResult(const GS::UniString& baseUrl, bool isExported, const std::string& errorStr, ExportReport& report)
 {
-  // Export to url and alert user to success or failure
-  std::string baseUrlStr = baseUrl.ToCStr();
-  std::string errorStr;
-  if (DataExporter::ExportToUrl(exportJson, baseUrlStr, JsonIndentWidth, errorStr))
+  if (isExported)
   {
-    GS::UniString alertText = "Data sucessfully exported to " + baseUrl;
+    GS::UniString alertText = "Data sucessfully exported to " + baseUrl + "\n\n" + report.GetSummary();
     DGAlert(DG_INFORMATION, "Export to URL", "", alertText, "OK");
   }
   else
   {
+    report.AddCount(ExportCounter::Failures);
     DGAlert(DG_ERROR, "Export to URL", "", GS::UniString(errorStr), "OK");
   }
 }
+
+void JsonExportUtils::ShowServerResult(UInt32 port, UInt32 elementCount, bool isServed, const std::string& errorStr, ExportReport& report)
+{
+  if (isServed)
+  {
+    GS::UniString alertText = GS::UniString::Printf("Serving %u elements at http://127.0.0.1:%u", elementCount, port) + "\n\n" + report.GetSummary();
+    DGAlert(DG_INFORMATION, "Local Server", "", alertText, "OK");
+  }
+  else
+  {
+    report.AddCount(ExportCounter::Failures);
+    DGAlert(DG_ERROR, "Local Server", "", GS::UniString(errorStr), "OK");
+  }
+}
+
+void JsonExportUtils::WriteReportFiles(const ExportPlan& plan, const ExportReport& report, const CancellationToken& cancellationToken, bool isIncremental, bool isPlanReused)
+{
+  const JsonExportSettingsData& settingsData = plan.GetSettings();
+  const PropertyCache& sessionCache = PropertyCache::GetSessionCache();
+
+  // Write the report, plan and trace alongside the exported file
+  if (settingsData.exportToFile)
+  {
+    const std::string& filePathStr = plan.GetFilePath();
+    UInt64 propertyCacheHits = report.GetCount(ExportCounter::PropertyCacheHits);
+    UInt64 propertyCacheLookups = propertyCacheHits + report.GetCount(ExportCounter::PropertyCacheMisses);
+    json reportJson = report.ToJson();
+    reportJson["format"] = plan.IsArrowFormat() ? "arrow" : "json";
+    reportJson["selectedOnly"] = settingsData.selectedOnly;
+    reportJson["propertyBatchSize"] = settingsData.propertyBatchSize;
+    reportJson["memory"]["budgetBytes"] = plan.GetMemoryBudgetBytes();
+    reportJson["memory"]["incremental"] = isIncremental;
+    reportJson["realDecimalPlaces"] = settingsData.realDecimalPlaces;
+    reportJson["propertyCache"]["enabled"] = settingsData.reuseUnchangedValues;
+    reportJson["propertyCache"]["hitRatio"] = propertyCacheLookups > 0 ? static_cast<double>(propertyCacheHits) / propertyCacheLookups : 0.0;
+    reportJson["propertyCache"]["elements"] = sessionCache.GetElementCount();
+    reportJson["propertyCache"]["bytes"] = sessionCache.GetMemorySize();
+    reportJson["knownFailingDefinitions"] = FailingDefinitionCache::GetSessionCache().GetDefinitionCount();
+    reportJson["planReused"] = isPlanReused;
+    reportJson["cancelled"] = cancellationToken.IsCancelled();
+    reportJson["cancellationMilliseconds"] = cancellationToken.GetStopMilliseconds();
+
+    // The report is still written for cancelled exports, so it is not subject to cancellation itself
+    std::string errorStr;
+    CancellationToken reportCancellationToken;
+    DataExporter::ExportToFile(reportJson.dump(JsonIndentWidth) + "\n", GetSiblingFilePath(filePathStr, ReportFileName), reportCancellationToken, errorStr);
+    DataExporter::ExportToFile(plan.Explain().dump(JsonIndentWidth) + "\n", GetSiblingFilePath(filePathStr, PlanFileName), reportCancellationToken, errorStr);
+
+    if (settingsData.recordTrace)
+      DataExporter::ExportToFile(TraceRecorder::ToJson().dump() + "\n", GetSiblingFilePath(filePathStr, TraceFileName), reportCancellationToken, errorStr);
+  }
+}
+
+std::string JsonExportUtils::GetTemporaryFilePath()
+{
+  // Name the file randomly, so that exports from other Archicad sessions do not write to the same one
+  std::filesystem::path directory = std::filesystem::temp_directory_path();
+  std::mt19937_64 random(std::random_device{}());
+  std::filesystem::path filePath;
+  do
+  {
+    char fileName[48];
+    std::snprintf(fileName, sizeof(fileName), "%s%016llx.json", TemporaryFilePrefix, static_cast<unsigned long long>(random()));
+    filePath = directory / fileName;
+  } while (std::filesystem::exists(filePath));
+  return filePath.string();
+}
+
+std::string JsonExportUtils::GetSiblingFilePath(const std::string& exportFilePath, const std::string& fileName)
+{
+  // Place the file in the same directory as the exported file
+  size_t separatorPos = exportFilePath.find_last_of("/\\");
+  std::string directory = separatorPos == std::string::npos ? std::string() : exportFilePath.substr(0, separatorPos + 1);
+  return directory + fileName;
+}
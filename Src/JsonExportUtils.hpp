@@ -1,26 +1,208 @@
 #pragma once
 
-#include "ElementData.hpp"
+#include "CancellationToken.hpp"
+#include "ElementFilter.hpp"
+#include "ElementHeaderCache.hpp"
+#include "ExportPlan.hpp"
+#include "ElementSnapshot.hpp"
+#include "ElementStore.hpp"
+#include "ExportProgress.hpp"
+#include "FailingDefinitionCache.hpp"
 #include "JsonExportSettingsData.hpp"
-#include "Thirdparty/json.hpp"
+#include "JsonParser.hpp"
+#include "JsonWriter.hpp"
+#include "PropertyAllowList.hpp"
+#include "PropertyCache.hpp"
+#include "ExportReport.hpp"
+#include "TimeSlicer.hpp"
 
-using json = nlohmann::json;
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The estimated output size and duration of an export in each format, extrapolated from a random sample of
+ * its candidate elements. Durations cover collecting, fetching and serializing elements, but not writing or uploading.
+ * On models too large to list in the time allowed, the number of candidates is itself extrapolated.
+ */
+struct ExportEstimate
+{
+  UInt64 candidateElements;
+  UInt64 sampledElements;
+  UInt64 jsonBytes;
+  double jsonSeconds;
+  UInt64 arrowBytes;
+  double arrowSeconds;
+};
 
 class JsonExportUtils {
 public:
   JsonExportUtils() = delete; // prevent instantiation of this class
 
-  static void RunExportProcess(const JsonExportSettingsData& settingsData);
+  static void EstimateExport(const JsonExportSettingsData& settingsData, ExportEstimate& estimate);
+  static bool RunPrefetchSlice(const JsonExportSettingsData& settingsData);
+  static void ClearPrefetch();
+  static void StartExportJob(const JsonExportSettingsData& settingsData, ExportProgressListener* progressListener = nullptr);
+  static bool RunExportJobSlice();
+  static void CancelExportJob();
+  static void AbandonExportJob();
+  static bool IsExportJobRunning();
   static void GetAvailableElementTypeNames(bool selectionOnly, GS::Array<GS::UniString>& elemTypeNames);
   static bool IsAnyElementsSelected();
 
 private:
-  static void BuildElementData(const GS::Array<API_Guid>& elemGuids, const GS::Array<API_PropertyDefinitionFilter>& filters, GS::Array<ElementData>& data);
-  static bool GetElementProperties(const API_Guid& elemGuid, const GS::Array<API_PropertyDefinitionFilter>& filters, GS::Array<API_Property>& properties);
-  static void GetElementsFromTypes(const GS::Array<API_ElemTypeID>& elemTypes, GS::Array<API_Guid>& elemGuids);
-  static void FilterElementsByType(const GS::Array<API_ElemTypeID>& elemTypes, const GS::Array<API_Guid>& inputElemGuids, GS::Array<API_Guid>& outputGuids);
+  /**
+   * @brief Cached name and visibility of a layer attribute
+   */
+  struct LayerName
+  {
+    API_AttributeIndex index;
+    GS::UniString name;
+    bool isHidden;
+  };
+
+  /**
+   * @brief Elements whose headers and property definitions have been resolved, awaiting their property values.
+   * Elements with identical definitions share a definition set, whose definition list is reused for each of them.
+   * Each set also has a hash of its definitions, used to tell whether cached values were fetched for the same ones.
+   * Sets are keyed by their definition guids, so that elements can be added over several calls to CollectElements.
+   * Layer names are looked up by the layer's attribute index.
+   */
+  struct PendingElements
+  {
+    std::vector<API_Guid> elemGuids;
+    std::vector<API_ElemTypeID> elemTypeIds;
+    std::vector<UInt32> layerIndices;
+    std::vector<UInt64> modiStamps;
+    std::vector<size_t> definitionSetIndices;
+    std::vector<GS::Array<API_Guid>> definitionSets;
+    std::vector<UInt64> definitionSetHashes;
+    std::unordered_map<std::string, size_t> definitionSetKeys;
+    std::vector<LayerName> layerNames;
+    std::unordered_map<Int32, UInt32> layerNameIndices;
+  };
+
+  /**
+   * @brief Collection work done ahead of an export while the dialog is idle. Element guids are listed first, an
+   * element type or group of selected elements at a time, and are then collected a group at a time. The work is
+   * only taken over by an export whose settings have the same collection fingerprint.
+   */
+  struct PrefetchState
+  {
+    explicit PrefetchState(const JsonExportSettingsData& settingsData);
+
+    UInt64 fingerprint;
+    ElementFilter elementFilter;
+    ElementHeaderCache headers;
+    ExportReport report;
+    GS::Array<API_Guid> selectedGuids;
+    USize listedCount;
+    bool isListed;
+    GS::Array<API_Guid> elemGuids;
+    USize collectedCount;
+    PendingElements pending;
+    TimeSlicer slicer;
+  };
+
+  /**
+   * @brief The outcome of writing, uploading and preparing to serve an export, which is only shown once the export
+   * has finished. The snapshot is only built for exports served by the local server.
+   */
+  struct ExportOutput
+  {
+    bool isWritten = false;
+    bool isUploaded = false;
+    std::string fileErrorStr;
+    std::string urlErrorStr;
+    std::shared_ptr<const ElementSnapshot> snapshot;
+  };
+
+  /**
+   * @brief An export run on the API thread in short slices of idle time, so that Archicad stays responsive while it
+   * runs. Its plan, collection state, the cursor into the elements whose values are being fetched, and the store of
+   * fetched values are kept between slices. Batched exports keep their writer and the file being written instead of
+   * the store. Serializing, writing and uploading run on a worker thread once every value is fetched, which later
+   * slices check on, so progress reaches the listener through a relay. Element type names are resolved on the API
+   * thread before the worker starts, as it cannot call the API.
+   */
+  struct ExportJob
+  {
+    ExportJob(const JsonExportSettingsData& settingsData, ExportProgressListener* progressListener);
+
+    JsonExportSettingsData settings;
+    std::shared_ptr<ExportPlan> plan;
+    bool isPlanReused;
+    ExportReport report;
+    CancellationToken cancellationToken;
+    ExportProgressRelay progressRelay;
+    ExportProgressReporter progress;
+    std::unique_ptr<PrefetchState> collection;
+    bool isCollected;
+    bool isIncremental;
+    PropertyCache* propertyCache;
+    std::vector<size_t> elemIndices;
+    size_t fetchedCount;
+    ElementStore store;
+    std::vector<GS::UniString> elemTypeNames;
+    JsonWriter incrementalWriter;
+    JsonParser::IncrementalState incrementalState;
+    std::string outputFilePath;
+    bool isOutputStarted;
+    ExportOutput output;
+    std::future<void> outputTask;
+    TimeSlicer slicer;
+  };
+
+  /**
+   * @brief The names an element is ordered by in the json output
+   */
+  struct ElementSortKey
+  {
+    std::string layerName;
+    std::string elemTypeName;
+    std::string elemGuid;
+    size_t index;
+  };
+
+  static std::unique_ptr<PrefetchState>& GetPrefetchState();
+  static bool RunPrefetchStep(const ExportPlan& plan, const JsonExportSettingsData& settingsData, PrefetchState& state, USize groupSize, ExportReport& report);
+  static std::unique_ptr<ExportJob>& GetExportJob();
+  static bool RunExportJobStep(ExportPlan& plan, ExportJob& job, USize groupSize);
+  static void FinishExportJob(const ExportPlan& plan, ExportJob& job);
+  static bool IsIncrementalExport(const ExportPlan& plan, const PendingElements& pending);
+  static PropertyCache* PreparePropertyCache(const ExportPlan& plan);
+  static bool RunIncrementalStep(const ExportPlan& plan, ExportJob& job, const std::vector<size_t>& groupIndices);
+  static bool StartExportOutput(const ExportPlan& plan, ExportJob& job);
+  static void WriteExportOutput(const ExportPlan& plan, ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ExportOutput& output);
+  static bool SerializeStore(const ExportPlan& plan, const ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, std::string& exportData);
+  static void UploadExportFile(const ExportPlan& plan, const std::string& filePath, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ExportOutput& output);
+  static void RemoveOutputFile(const ExportJob& job);
+  static void PublishSnapshot(const ExportPlan& plan, const std::shared_ptr<const ElementSnapshot>& snapshot, ExportReport& report);
+  static void ResolveElemTypeNames(const ElementStore& store, std::vector<GS::UniString>& elemTypeNames);
+  static void CollectElements(const GS::Array<API_Guid>& elemGuids, const GS::Array<API_PropertyDefinitionFilter>& filters, const PropertyAllowList& allowList, ElementFilter& elementFilter, ElementHeaderCache& headers, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, PendingElements& pending);
+  static bool FetchPropertyValues(const PendingElements& pending, const std::vector<size_t>& elemIndices, UInt32 batchSize, PropertyCache* propertyCache, FailingDefinitionCache& failingDefinitions, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ElementStore& store);
+  static void AddToPlanEstimates(const PendingElements& pending, ExportPlan& plan);
+  static void AddLayersToStore(const PendingElements& pending, ElementStore& store);
+  static void SortElementsInKeyOrder(const PendingElements& pending, std::vector<size_t>& order);
+  static UInt64 EstimateElementSize(const PendingElements& pending, size_t elemIndex);
+  static UInt64 EstimateExportSize(const PendingElements& pending);
+  static UInt32 GetLayerNameIndex(const API_AttributeIndex& layerIndex, PendingElements& pending, ExportReport& report);
+  static Int32 GetAttributeIndexKey(const API_AttributeIndex& attributeIndex);
+  static bool GetElementPropertyDefinitions(const API_Guid& elemGuid, const GS::Array<API_PropertyDefinitionFilter>& filters, const PropertyAllowList& allowList, GS::Array<API_Guid>& definitionGuids, UInt64& definitionsHash);
+  static void FetchPropertyValueBatch(const PendingElements& pending, const std::vector<size_t>& elemIndices, size_t batchStart, size_t batchEnd, PropertyCache* propertyCache, FailingDefinitionCache& failingDefinitions, ExportReport& report, ElementStore& store);
+  static void GetElementsFromTypes(const GS::Array<API_ElemTypeID>& elemTypes, CancellationToken& cancellationToken, GS::Array<API_Guid>& elemGuids);
+  static void FilterElementsByType(const GS::Array<API_ElemTypeID>& elemTypes, const GS::Array<API_Guid>& inputElemGuids, ElementHeaderCache& headers, ExportReport& report, GS::Array<API_Guid>& outputGuids);
   static void GetSelectedElements(GS::Array<API_Guid>& elemGuids);
-  static void GetElementTypesFromNames(const GS::Array<GS::UniString>& elemTypeNames, GS::Array<API_ElemTypeID>& elemTypes);
-  static void RunExportToFile(const GS::UniString& filePath, const json& exportJson);
-  static void RunExportToUrl(const GS::UniString& baseUrl, const json& exportJson);
+  static void RunExportToFile(const GS::UniString& filePath, const std::string& exportData, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ExportOutput& output);
+  static void RunExportToUrl(const GS::UniString& baseUrl, const std::string& exportData, const std::string& contentType, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ExportOutput& output);
+  static void RunExportToFileAndUrl(const GS::UniString& filePath, const GS::UniString& baseUrl, const std::string& exportData, const std::string& contentType, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, ExportOutput& output);
+  static bool ExportChunkToFile(const std::string& chunk, const std::string& filePath, bool append, ExportReport& report, CancellationToken& cancellationToken, ExportProgressReporter& progress, std::string& errorStr);
+  static void ShowFileExportResult(const GS::UniString& filePath, bool isExported, const std::string& errorStr, ExportReport& report);
+  static void ShowUrlExportResult(const GS::UniString& baseUrl, bool isExported, const std::string& errorStr, ExportReport& report);
+  static void ShowServerResult(UInt32 port, UInt32 elementCount, bool isServed, const std::string& errorStr, ExportReport& report);
+  static void WriteReportFiles(const ExportPlan& plan, const ExportReport& report, const CancellationToken& cancellationToken, bool isIncremental, bool isPlanReused);
+  static std::string GetTemporaryFilePath();
+  static std::string GetSiblingFilePath(const std::string& exportFilePath, const std::string& fileName);
 };
\ No newline at end of file
@@ -1,102 +1,299 @@
 #include "JsonParser.hpp"
+#include "GuidFormatter.hpp"
+#include "TraceRecorder.hpp"
+
+#include <algorithm>
+#include <numeric>
 
 /**
- * @brief Transforms a collection of supplied element and properties data into json format
- * @param[in] elemDataList Array of element data to process
- * @param[out] resultJson The json structure to write to
+ * @brief Transforms a collection of supplied element and properties data into json format. Layer, type and
+ * property names are interned once per export and their keys are written from pre-escaped bytes.
+ * @param[in] store The elements and property values to process
+ * @param[in] elemTypeNames The name of each element type, indexed by type id, resolved beforehand so that parsing
+ * does not call the Archicad API
+ * @param[out] report The report to add parse and serialize timings to
+ * @param[in] cancellationToken Token checked before each element is written
+ * @param[out] writer The json writer to write to
+ * @returns False if the export was cancelled, in which case the written json is incomplete
  */
-void JsonParser::Parse(const GS::Array<ElementData>& elemDataList, json& resultJson)
+bool JsonParser::Parse(const ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, ExportReport& report, CancellationToken& cancellationToken, JsonWriter& writer)
 {
-  for (const ElementData& elemData : elemDataList)
+  StringTable strings;
+  std::vector<UInt32> definitionNameIds;
+  std::vector<UInt32> ranks;
+  std::vector<UInt32> definitionRanks;
+  std::vector<ElementEntry> entries;
+
   {
-    if (!elemData.properties.IsEmpty())
-      ParseElement(elemData, resultJson);
+    ExportReport::ScopedPhase phase(report, ExportPhase::Parse);
+    InternEntries(store, elemTypeNames, strings, definitionNameIds, entries);
+
+    // Sort elements into key order, grouping them by layer and then type
+    TraceRecorder::ScopedSpan sortSpan("Sort elements", "parse");
+    strings.GetSortRanks(ranks);
+    GetDefinitionRanks(store, definitionNameIds, ranks, definitionRanks);
+    std::stable_sort(entries.begin(), entries.end(), [&ranks](const ElementEntry& a, const ElementEntry& b)
+    {
+      if (a.layerNameId != b.layerNameId)
+        return ranks[a.layerNameId] < ranks[b.layerNameId];
+      if (a.elemTypeNameId != b.elemTypeNameId)
+        return ranks[a.elemTypeNameId] < ranks[b.elemTypeNameId];
+      return a.elemKey < b.elemKey;
+    });
   }
+
+  ExportReport::ScopedPhase phase(report, ExportPhase::Serialize);
+  IncrementalState state;
+  BeginIncremental(writer);
+  if (!WriteEntries(store, entries, strings, definitionNameIds, definitionRanks, state, cancellationToken, writer))
+    return false;
+
+  EndIncremental(state, writer);
+  return true;
 }
 
-void JsonParser::ParseElement(const ElementData& elemData, json& elemJson)
+/**
+ * @brief Starts an incremental export, in which elements are written in batches rather than all at once
+ * @param[out] writer The json writer to write to
+ */
+void JsonParser::BeginIncremental(JsonWriter& writer)
 {
-  // Get element properties json
-  json elemPropertiesJson;
-  for (const API_Property& prop : elemData.properties)
-    ParseJsonFromProperty(prop, elemPropertiesJson);
+  writer.BeginObject();
+}
 
-  // Get element type name
-  GS::UniString elemTypeNameUniStr;
-  ACAPI_Element_GetElemTypeName(elemData.elemTypeId, elemTypeNameUniStr);
-  std::string elemTypeName = elemTypeNameUniStr.ToCStr();
+/**
+ * @brief Writes a batch of elements as part of an incremental export. Batches must be supplied in key order,
+ * i.e. sorted by layer name, then type name, then guid string, comparing the UTF-8 bytes of each. The output
+ * of all batches is then identical to that of Parse.
+ * @param[in] store The elements and property values, in key order
+ * @param[in] elemTypeNames The name of each element type, indexed by type id
+ * @param[in,out] state The groups left open by the previous batch
+ * @param[out] report The report to add parse and serialize timings to
+ * @param[in] cancellationToken Token checked before each element is written
+ * @param[out] writer The json writer to write to
+ * @returns False if the export was cancelled, in which case the written json is incomplete
+ */
+bool JsonParser::ParseIncremental(const ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, IncrementalState& state, ExportReport& report, CancellationToken& cancellationToken, JsonWriter& writer)
+{
+  StringTable strings;
+  std::vector<UInt32> definitionNameIds;
+  std::vector<UInt32> ranks;
+  std::vector<UInt32> definitionRanks;
+  std::vector<ElementEntry> entries;
 
-  // Get element and layer names
-  std::string elemName = APIGuidToString(elemData.elemGuid).ToCStr();
-  std::string layerName = elemData.layerName.ToCStr();
+  {
+    ExportReport::ScopedPhase phase(report, ExportPhase::Parse);
+    InternEntries(store, elemTypeNames, strings, definitionNameIds, entries);
+    strings.GetSortRanks(ranks);
+    GetDefinitionRanks(store, definitionNameIds, ranks, definitionRanks);
+  }
 
-  elemJson[layerName][elemTypeName][elemName] = elemPropertiesJson;
+  ExportReport::ScopedPhase phase(report, ExportPhase::Serialize);
+  return WriteEntries(store, entries, strings, definitionNameIds, definitionRanks, state, cancellationToken, writer);
 }
 
-void JsonParser::ParseJsonFromProperty(const API_Property& prop, json& propertyJson)
+/**
+ * @brief Finishes an incremental export, closing any groups left open
+ * @param[in] state The groups left open by the last batch
+ * @param[out] writer The json writer to write to
+ */
+void JsonParser::EndIncremental(const IncrementalState& state, JsonWriter& writer)
 {
-  std::string name = prop.definition.name.ToCStr();
-  bool isSingle =
-    prop.definition.collectionType != API_PropertyListCollectionType &&
-    prop.definition.collectionType != API_PropertyMultipleChoiceEnumerationCollectionType;
+  if (state.hasElements)
+  {
+    writer.EndObject();
+    writer.EndObject();
+  }
+  writer.EndObject();
+}
 
-  if (isSingle)
+void JsonParser::InternEntries(const ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, StringTable& strings, std::vector<UInt32>& definitionNameIds, std::vector<ElementEntry>& entries)
+{
+  // Intern all names used by the elements, once per layer, type and property definition
+  TraceRecorder::ScopedSpan internSpan("Intern names", "parse");
+  std::vector<UInt32> layerNameIds(store.GetLayerCount(), UINT32_MAX);
+  std::vector<UInt32> elemTypeNameIds;
+  entries.reserve(store.GetElementCount());
+
+  for (UInt32 i = 0; i < store.GetDefinitionCount(); ++i)
+    definitionNameIds.push_back(strings.Intern(store.GetDefinition(i).name));
+
+  for (UInt32 i = 0; i < store.GetElementCount(); ++i)
+  {
+    // Guid text never needs escaping, so it is quoted directly
+    std::string elemKey;
+    elemKey.reserve(GuidFormatter::Length + 2);
+    elemKey.push_back('"');
+    GuidFormatter::Append(elemKey, store.GetElementGuid(i));
+    elemKey.push_back('"');
+
+    UInt32 layerIndex = store.GetLayerIndex(i);
+    if (layerNameIds[layerIndex] == UINT32_MAX)
+      layerNameIds[layerIndex] = strings.Intern(store.GetLayerName(layerIndex));
+
+    UInt32 elemTypeNameId = InternElemTypeName(store.GetElementTypeId(i), elemTypeNames, strings, elemTypeNameIds);
+    entries.push_back({ i, layerNameIds[layerIndex], elemTypeNameId, elemKey });
+  }
+}
+
+/**
+ * @brief Ranks property definitions in the order their properties are written in, i.e. by name and then by guid for
+ * definitions sharing a name. Of properties whose names are repeated, the one ranked last is kept.
+ * @param[in] store The store holding the definitions
+ * @param[in] definitionNameIds The interned name of each definition
+ * @param[in] ranks The sort rank of each interned string, as given by StringTable::GetSortRanks
+ * @param[out] definitionRanks The rank of each definition
+ */
+void JsonParser::GetDefinitionRanks(const ElementStore& store, const std::vector<UInt32>& definitionNameIds, const std::vector<UInt32>& ranks, std::vector<UInt32>& definitionRanks)
+{
+  // Order definitions by name, and definitions sharing a name by guid, so that which of them is kept does not
+  // depend on the order Archicad returned them in
+  std::vector<std::string> guidTexts(store.GetDefinitionCount());
+  std::vector<UInt32> order(store.GetDefinitionCount());
+  for (UInt32 i = 0; i < store.GetDefinitionCount(); ++i)
+  {
+    GuidFormatter::Append(guidTexts[i], store.GetDefinition(i).guid);
+    order[i] = i;
+  }
+
+  std::sort(order.begin(), order.end(), [&definitionNameIds, &ranks, &guidTexts](UInt32 a, UInt32 b)
+  {
+    if (definitionNameIds[a] != definitionNameIds[b])
+      return ranks[definitionNameIds[a]] < ranks[definitionNameIds[b]];
+    return guidTexts[a] < guidTexts[b];
+  });
+
+  definitionRanks.resize(order.size());
+  for (UInt32 i = 0; i < order.size(); ++i)
+    definitionRanks[order[i]] = i;
+}
+
+bool JsonParser::WriteEntries(const ElementStore& store, const std::vector<ElementEntry>& entries, const StringTable& strings, const std::vector<UInt32>& definitionNameIds, const std::vector<UInt32>& definitionRanks, IncrementalState& state, CancellationToken& cancellationToken, JsonWriter& writer)
+{
+  for (size_t i = 0; i < entries.size(); ++i)
   {
-    // Extract json string value from single variant
-    const auto& singleVariant = prop.value.singleVariant.variant;
+    const ElementEntry& entry = entries[i];
+    if (cancellationToken.IsCancelled())
+      return false;
 
-    switch (prop.definition.valueType)
+    // Skip elements that are repeated later, the last occurrence is kept
+    if (i + 1 < entries.size() && entries[i + 1].elemKey == entry.elemKey)
+      continue;
+
+    std::string_view layerKey = strings.GetKey(entry.layerNameId);
+    std::string_view elemTypeKey = strings.GetKey(entry.elemTypeNameId);
+    bool isNewLayer = !state.hasElements || state.layerKey != layerKey;
+    bool isNewType = isNewLayer || state.elemTypeKey != elemTypeKey;
+
+    // Close off the previous groups and open new ones as required
+    if (state.hasElements && isNewType)
+      writer.EndObject();
+    if (state.hasElements && isNewLayer)
+      writer.EndObject();
+
+    if (isNewLayer)
     {
-    case API_PropertyUndefinedValueType:
-      propertyJson[name] = "";
-      break;
-    case API_PropertyIntegerValueType:
-      propertyJson[name] = singleVariant.intValue;
-      break;
-    case API_PropertyRealValueType:
-      propertyJson[name] = singleVariant.doubleValue;
-      break;
-    case API_PropertyStringValueType:
-      propertyJson[name] = singleVariant.uniStringValue.ToCStr();
-      break;
-    case API_PropertyBooleanValueType:
-      propertyJson[name] = singleVariant.boolValue;
-      break;
-    case API_PropertyGuidValueType:
-      propertyJson[name] = APIGuidToString(singleVariant.guidValue).ToCStr();
+      writer.WriteKey(layerKey);
+      writer.BeginObject();
+      state.layerKey = layerKey;
     }
+    if (isNewType)
+    {
+      writer.WriteKey(elemTypeKey);
+      writer.BeginObject();
+      state.elemTypeKey = elemTypeKey;
+    }
+
+    ParseElement(store, entry, strings, definitionNameIds, definitionRanks, writer);
+    state.hasElements = true;
   }
-  else
+  return true;
+}
+
+void JsonParser::ParseElement(const ElementStore& store, const ElementEntry& entry, const StringTable& strings, const std::vector<UInt32>& definitionNameIds, const std::vector<UInt32>& definitionRanks, JsonWriter& writer)
+{
+  UInt32 firstProperty = store.GetFirstProperty(entry.elemIndex);
+  auto getNameId = [&store, &definitionNameIds](UInt32 propertyIndex)
+  {
+    return definitionNameIds[store.GetProperty(propertyIndex).definitionIndex];
+  };
+
+  // Sort properties into key order
+  std::vector<UInt32> order(store.GetPropertyEnd(entry.elemIndex) - firstProperty);
+  std::iota(order.begin(), order.end(), firstProperty);
+  std::stable_sort(order.begin(), order.end(), [&store, &definitionRanks](UInt32 a, UInt32 b)
+  {
+    return definitionRanks[store.GetProperty(a).definitionIndex] < definitionRanks[store.GetProperty(b).definitionIndex];
+  });
+
+  writer.WriteKey(entry.elemKey);
+  writer.BeginObject();
+  for (size_t i = 0; i < order.size(); ++i)
   {
-    // Construct json string value from list variant
-    const auto& listVariants = prop.value.listVariant.variants;
-    json variantsJson = json::array();
+    // Skip properties whose names are repeated later, the one whose definition guid sorts last is kept
+    UInt32 nameId = getNameId(order[i]);
+    if (i + 1 < order.size() && getNameId(order[i + 1]) == nameId)
+      continue;
 
-    switch (prop.definition.valueType)
+    writer.WriteKey(strings.GetKey(nameId));
+    ParseJsonFromProperty(store, store.GetProperty(order[i]), writer);
+  }
+  writer.EndObject();
+}
+
+/**
+ * @brief Writes the value of a property, as a single value or as an array of the items of a list property
+ * @param[in] store The store holding the property's values
+ * @param[in] prop The property to write
+ * @param[out] writer The json writer to write to
+ */
+void JsonParser::ParseJsonFromProperty(const ElementStore& store, const ElementStore::Property& prop, JsonWriter& writer)
+{
+  // Single properties are written as a value and list properties as an array of their items
+  bool isList = store.GetDefinition(prop.definitionIndex).IsList();
+  if (isList)
+    writer.BeginArray();
+
+  for (UInt32 i = prop.firstValue; i < prop.firstValue + prop.valueCount; ++i)
+  {
+    const ElementStore::Value& value = store.GetValue(i);
+    switch (value.type)
     {
     case API_PropertyUndefinedValueType:
+      // Undefined single values are written as empty strings, lists of undefined type as empty arrays
+      if (!isList)
+        writer.WriteString("");
       break;
     case API_PropertyIntegerValueType:
-      for (const auto& variant : listVariants)
-        variantsJson.push_back(variant.intValue);
+      writer.WriteInt(value.intValue);
       break;
     case API_PropertyRealValueType:
-      for (const auto& variant : listVariants)
-        variantsJson.push_back(variant.doubleValue);
+      writer.WriteDouble(value.realValue);
       break;
     case API_PropertyStringValueType:
-      for (const auto& variant : listVariants)
-        variantsJson.push_back(variant.uniStringValue.ToCStr());
+      writer.WriteString(store.GetString(value));
       break;
     case API_PropertyBooleanValueType:
-      for (const auto& variant : listVariants)
-        variantsJson.push_back(variant.boolValue);
+      writer.WriteBool(value.boolValue);
       break;
     case API_PropertyGuidValueType:
-      for (const auto& variant : listVariants)
-        variantsJson.push_back(APIGuidToString(variant.guidValue).ToCStr());
+      writer.WriteGuid(store.GetGuid(value));
       break;
     }
-    propertyJson[name] = variantsJson;
   }
-}
\ No newline at end of file
+
+  if (isList)
+    writer.EndArray();
+}
+
+UInt32 JsonParser::InternElemTypeName(API_ElemTypeID elemTypeId, const std::vector<GS::UniString>& elemTypeNames, StringTable& strings, std::vector<UInt32>& elemTypeNameIds)
+{
+  // Type names are interned once per type rather than once per element
+  size_t index = static_cast<size_t>(elemTypeId);
+  if (index >= elemTypeNameIds.size())
+    elemTypeNameIds.resize(index + 1, UINT32_MAX);
+
+  if (elemTypeNameIds[index] == UINT32_MAX)
+    elemTypeNameIds[index] = strings.Intern(index < elemTypeNames.size() ? elemTypeNames[index] : GS::UniString());
+  return elemTypeNameIds[index];
+}
@@ -1,18 +1,47 @@
 #pragma once
 
 #include "ACAPinc.h"
-#include "ThirdParty/json.hpp"
-#include "ElementData.hpp"
+#include "CancellationToken.hpp"
+#include "ElementStore.hpp"
+#include "ExportReport.hpp"
+#include "JsonWriter.hpp"
+#include "StringTable.hpp"
 
-using json = nlohmann::json;
+#include <string>
+#include <vector>
 
 class JsonParser {
 public:
   JsonParser() = delete; // prevent instantiation of this class
 
-  static void Parse(const GS::Array<ElementData>& elemDataList, json& resultJson);
+  /**
+   * @brief The layer and type groups left open between the batches of an incremental export
+   */
+  struct IncrementalState
+  {
+    std::string layerKey;
+    std::string elemTypeKey;
+    bool hasElements = false;
+  };
+
+  static bool Parse(const ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, ExportReport& report, CancellationToken& cancellationToken, JsonWriter& writer);
+  static void BeginIncremental(JsonWriter& writer);
+  static bool ParseIncremental(const ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, IncrementalState& state, ExportReport& report, CancellationToken& cancellationToken, JsonWriter& writer);
+  static void EndIncremental(const IncrementalState& state, JsonWriter& writer);
+  static void GetDefinitionRanks(const ElementStore& store, const std::vector<UInt32>& definitionNameIds, const std::vector<UInt32>& ranks, std::vector<UInt32>& definitionRanks);
+  static void ParseJsonFromProperty(const ElementStore& store, const ElementStore::Property& prop, JsonWriter& writer);
 
 private:
-  static void ParseElement(const ElementData& elemData, json& elemJson);
-  static void ParseJsonFromProperty(const API_Property& prop, json& propertyJson);
-};
\ No newline at end of file
+  struct ElementEntry
+  {
+    UInt32 elemIndex;
+    UInt32 layerNameId;
+    UInt32 elemTypeNameId;
+    std::string elemKey;
+  };
+
+  static void InternEntries(const ElementStore& store, const std::vector<GS::UniString>& elemTypeNames, StringTable& strings, std::vector<UInt32>& definitionNameIds, std::vector<ElementEntry>& entries);
+  static bool WriteEntries(const ElementStore& store, const std::vector<ElementEntry>& entries, const StringTable& strings, const std::vector<UInt32>& definitionNameIds, const std::vector<UInt32>& definitionRanks, IncrementalState& state, CancellationToken& cancellationToken, JsonWriter& writer);
+  static void ParseElement(const ElementStore& store, const ElementEntry& entry, const StringTable& strings, const std::vector<UInt32>& definitionNameIds, const std::vector<UInt32>& definitionRanks, JsonWriter& writer);
+  static UInt32 InternElemTypeName(API_ElemTypeID elemTypeId, const std::vector<GS::UniString>& elemTypeNames, StringTable& strings, std::vector<UInt32>& elemTypeNameIds);
+};
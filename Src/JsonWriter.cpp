@@ -0,0 +1,402 @@
+#include "JsonWriter.hpp"
+#include "CpuFeatures.hpp"
+#include "GuidFormatter.hpp"
+#include "Thirdparty/json.hpp"
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#ifdef EXPORT_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef EXPORT_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Real values are written in fixed notation for decimal exponents in this range, as with nlohmann::json
+const int MinFixedExponent = -4;
+const int MaxFixedExponent = std::numeric_limits<double>::digits10;
+
+// Doubles of at least this magnitude have no fractional part
+const double MinIntegralMagnitude = 9007199254740992.0;
+
+// Whole numbers below this magnitude are written in fixed notation
+const double MaxFixedIntegral = 1e15;
+
+/**
+ * @brief Writes the shortest representation of a finite double that reads back as the same value, laid out the
+ * same way as nlohmann::json::dump
+ * @returns The end of the written characters
+ */
+char* FormatReal(char* first, char* last, double value)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  if (std::signbit(value))
+  {
+    value = -value;
+    *first++ = '-';
+  }
+  if (value == 0.0)
+  {
+    std::memcpy(first, "0.0", 3);
+    return first + 3;
+  }
+
+  // Whole numbers written in fixed notation are just their integer digits, which are cheaper to produce
+  if (value < MaxFixedIntegral && value == std::trunc(value))
+  {
+    first = std::to_chars(first, last, static_cast<Int64>(value)).ptr;
+    std::memcpy(first, ".0", 2);
+    return first + 2;
+  }
+
+  // Otherwise take the shortest round-trip digits from the standard library's scientific form d[.ddd]e+xx, and
+  // lay them out as nlohmann does
+  std::array<char, 32> scientific;
+  const char* scientificEnd = std::to_chars(scientific.data(), scientific.data() + scientific.size(), value, std::chars_format::scientific).ptr;
+  const char* c = scientific.data();
+
+  int digitCount = 0;
+  first[digitCount++] = *c++;
+  if (*c == '.')
+  {
+    for (++c; *c != 'e'; ++c)
+      first[digitCount++] = *c;
+  }
+
+  bool isNegativeExponent = c[1] == '-';
+  int exponent = 0;
+  for (c += 2; c != scientificEnd; ++c)
+    exponent = exponent * 10 + (*c - '0');
+  if (isNegativeExponent)
+    exponent = -exponent;
+
+  return nlohmann::detail::dtoa_impl::format_buffer(first, digitCount, exponent - (digitCount - 1), MinFixedExponent, MaxFixedExponent);
+#else
+  return nlohmann::detail::to_chars(first, last, value);
+#endif
+}
+
+bool NeedsEscape(unsigned char c)
+{
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+#ifdef EXPORT_SIMD_SSE2
+
+size_t FindEscapeSse2(const char* str, size_t length)
+{
+  const __m128i lastControl = _mm_set1_epi8(0x1F);
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16)
+  {
+    // Control characters are found with an unsigned comparison, so UTF-8 bytes above 0x7F are passed over
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    __m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(block, lastControl), block);
+    __m128i isEscaped = _mm_or_si128(isControl, _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)));
+
+    unsigned int escapedMask = static_cast<unsigned int>(_mm_movemask_epi8(isEscaped));
+    if (escapedMask != 0)
+      return i + CpuFeatures::CountTrailingZeros(escapedMask);
+  }
+  return i;
+}
+
+#endif
+
+#ifdef EXPORT_SIMD_AVX2
+
+EXPORT_TARGET_AVX2 size_t FindEscapeAvx2(const char* str, size_t length)
+{
+  const __m256i lastControl = _mm256_set1_epi8(0x1F);
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32)
+  {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    __m256i isControl = _mm256_cmpeq_epi8(_mm256_min_epu8(block, lastControl), block);
+    __m256i isEscaped = _mm256_or_si256(isControl, _mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, backslash)));
+
+    unsigned int escapedMask = static_cast<unsigned int>(_mm256_movemask_epi8(isEscaped));
+    if (escapedMask != 0)
+      return i + CpuFeatures::CountTrailingZeros(escapedMask);
+  }
+  return i;
+}
+
+#endif
+
+/**
+ * @brief Finds the first character needing escaping, checking a vector of characters at a time where supported
+ * @returns The index of the character, or the length of the string if there is none
+ */
+size_t FindEscape(const char* str, size_t length)
+{
+  size_t i = 0;
+#ifdef EXPORT_SIMD_AVX2
+  if (CpuFeatures::HasAvx2())
+    i = FindEscapeAvx2(str, length);
+  else
+    i = FindEscapeSse2(str, length);
+#elif defined(EXPORT_SIMD_SSE2)
+  i = FindEscapeSse2(str, length);
+#endif
+
+  // Check any characters left over after the last full vector
+  while (i < length && !NeedsEscape(static_cast<unsigned char>(str[i])))
+    ++i;
+  return i;
+}
+
+}
+
+/**
+ * @brief Constructs a writer with an empty output buffer
+ * @param[in] indentWidth The indent width for json elements. A negative width produces compact output.
+ */
+JsonWriter::JsonWriter(int indentWidth) :
+  m_indentWidth(indentWidth),
+  m_realScale(0.0),
+  m_afterKey(false)
+{
+}
+
+/**
+ * @brief Sets the precision real values are written with. By default they are written with the fewest digits that
+ * read back as the same value.
+ * @param[in] decimalPlaces The number of decimal places to round real values to, or a negative number to write
+ * them in full
+ */
+void JsonWriter::SetRealDecimalPlaces(int decimalPlaces)
+{
+  m_realScale = decimalPlaces >= 0 ? std::pow(10.0, decimalPlaces) : 0.0;
+}
+
+void JsonWriter::BeginObject()
+{
+  BeginScope('{');
+}
+
+void JsonWriter::EndObject()
+{
+  EndScope('}');
+}
+
+void JsonWriter::BeginArray()
+{
+  BeginScope('[');
+}
+
+void JsonWriter::EndArray()
+{
+  EndScope(']');
+}
+
+/**
+ * @brief Writes an object key. The key must already be quoted and escaped, e.g. as provided by a StringTable.
+ * @param[in] escapedKey The quoted and escaped key bytes
+ */
+void JsonWriter::WriteKey(std::string_view escapedKey)
+{
+  BeginValue();
+  m_buffer.append(escapedKey.data(), escapedKey.size());
+  m_buffer.append(m_indentWidth >= 0 ? ": " : ":");
+  m_afterKey = true;
+}
+
+void JsonWriter::WriteString(std::string_view str)
+{
+  BeginValue();
+  AppendQuoted(m_buffer, str);
+}
+
+/**
+ * @brief Writes a guid as a string, formatting it straight into the output buffer. Guid text never needs escaping.
+ * @param[in] guid The guid to write
+ */
+void JsonWriter::WriteGuid(const API_Guid& guid)
+{
+  BeginValue();
+  m_buffer.push_back('"');
+  GuidFormatter::Append(m_buffer, guid);
+  m_buffer.push_back('"');
+}
+
+void JsonWriter::WriteInt(int value)
+{
+  BeginValue();
+  std::array<char, 16> chars;
+  auto result = std::to_chars(chars.data(), chars.data() + chars.size(), value);
+  m_buffer.append(chars.data(), result.ptr);
+}
+
+void JsonWriter::WriteDouble(double value)
+{
+  BeginValue();
+
+  // Non-finite values have no JSON representation, nlohmann writes these as null
+  if (!std::isfinite(value))
+  {
+    m_buffer.append("null");
+    return;
+  }
+
+  // Round to the requested precision, leaving values too large to have decimal places as they are
+  if (m_realScale > 0.0 && std::fabs(value * m_realScale) < MinIntegralMagnitude)
+    value = std::round(value * m_realScale) / m_realScale;
+
+  std::array<char, 64> chars;
+  char* end = FormatReal(chars.data(), chars.data() + chars.size(), value);
+  m_buffer.append(chars.data(), end);
+}
+
+void JsonWriter::WriteBool(bool value)
+{
+  BeginValue();
+  m_buffer.append(value ? "true" : "false");
+}
+
+const std::string& JsonWriter::GetBuffer() const
+{
+  return m_buffer;
+}
+
+/**
+ * @brief Moves the output out of the writer, leaving it empty
+ * @returns The written json
+ */
+std::string JsonWriter::TakeBuffer()
+{
+  std::string buffer = std::move(m_buffer);
+  Clear();
+  return buffer;
+}
+
+/**
+ * @brief Moves the output written so far out of the writer. Open scopes are kept, so writing can continue and
+ * the flushed pieces concatenate to the same output as a single buffer.
+ * @returns The json written since the last flush
+ */
+std::string JsonWriter::FlushBuffer()
+{
+  std::string buffer = std::move(m_buffer);
+  m_buffer.clear();
+  return buffer;
+}
+
+void JsonWriter::Clear()
+{
+  m_buffer.clear();
+  m_scopeIsEmpty.clear();
+  m_afterKey = false;
+}
+
+/**
+ * @brief Appends a string to the output with JSON escaping applied, using the same escapes as nlohmann::json.
+ * Runs of characters needing no escaping are found a vector at a time and copied in one go.
+ * @param[out] out The string to append to
+ * @param[in] str The UTF-8 string to escape
+ */
+void JsonWriter::AppendEscaped(std::string& out, std::string_view str)
+{
+  static const char HexDigits[] = "0123456789abcdef";
+
+  size_t runStart = 0;
+  size_t i = FindEscape(str.data(), str.size());
+  while (i < str.size())
+  {
+    const unsigned char c = static_cast<unsigned char>(str[i]);
+
+    // Flush the run of characters that need no escaping
+    out.append(str.data() + runStart, i - runStart);
+    runStart = i + 1;
+
+    switch (c)
+    {
+    case '"':  out.append("\\\""); break;
+    case '\\': out.append("\\\\"); break;
+    case '\b': out.append("\\b"); break;
+    case '\f': out.append("\\f"); break;
+    case '\n': out.append("\\n"); break;
+    case '\r': out.append("\\r"); break;
+    case '\t': out.append("\\t"); break;
+    default:
+      out.append("\\u00");
+      out.push_back(HexDigits[c >> 4]);
+      out.push_back(HexDigits[c & 0x0F]);
+      break;
+    }
+
+    i = runStart + FindEscape(str.data() + runStart, str.size() - runStart);
+  }
+  out.append(str.data() + runStart, str.size() - runStart);
+}
+
+/**
+ * @brief Appends a string to the output as an escaped JSON string literal
+ * @param[out] out The string to append to
+ * @param[in] str The UTF-8 string to quote
+ */
+void JsonWriter::AppendQuoted(std::string& out, std::string_view str)
+{
+  out.push_back('"');
+  AppendEscaped(out, str);
+  out.push_back('"');
+}
+
+void JsonWriter::BeginValue()
+{
+  // Values directly following a key share its line
+  if (m_afterKey)
+  {
+    m_afterKey = false;
+    return;
+  }
+
+  if (m_scopeIsEmpty.empty())
+    return;
+
+  if (!m_scopeIsEmpty.back())
+    m_buffer.push_back(',');
+
+  m_scopeIsEmpty.back() = false;
+  AppendNewLine(m_scopeIsEmpty.size());
+}
+
+void JsonWriter::BeginScope(char openChar)
+{
+  BeginValue();
+  m_buffer.push_back(openChar);
+  m_scopeIsEmpty.push_back(true);
+}
+
+void JsonWriter::EndScope(char closeChar)
+{
+  // Empty scopes are closed on the same line, e.g. {} or []
+  bool isEmpty = m_scopeIsEmpty.back();
+  m_scopeIsEmpty.pop_back();
+
+  if (!isEmpty)
+    AppendNewLine(m_scopeIsEmpty.size());
+
+  m_buffer.push_back(closeChar);
+}
+
+void JsonWriter::AppendNewLine(size_t depth)
+{
+  if (m_indentWidth < 0)
+    return;
+
+  m_buffer.push_back('\n');
+  m_buffer.append(depth * static_cast<size_t>(m_indentWidth), ' ');
+}
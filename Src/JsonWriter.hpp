@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ACAPinc.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Streaming JSON writer that appends directly to an output buffer. The layout produced for a
+ * given indent width matches that of nlohmann::json::dump, so output stays identical to the DOM-based export.
+ */
+class JsonWriter {
+public:
+  explicit JsonWriter(int indentWidth);
+
+  void SetRealDecimalPlaces(int decimalPlaces);
+
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+
+  void WriteKey(std::string_view escapedKey);
+  void WriteString(std::string_view str);
+  void WriteGuid(const API_Guid& guid);
+  void WriteInt(int value);
+  void WriteDouble(double value);
+  void WriteBool(bool value);
+
+  const std::string& GetBuffer() const;
+  std::string TakeBuffer();
+  std::string FlushBuffer();
+  void Clear();
+
+  static void AppendEscaped(std::string& out, std::string_view str);
+  static void AppendQuoted(std::string& out, std::string_view str);
+
+private:
+  void BeginValue();
+  void BeginScope(char openChar);
+  void EndScope(char closeChar);
+  void AppendNewLine(size_t depth);
+
+  int m_indentWidth;
+  double m_realScale;
+  std::string m_buffer;
+  std::vector<bool> m_scopeIsEmpty;
+  bool m_afterKey;
+};
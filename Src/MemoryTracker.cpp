@@ -0,0 +1,56 @@
+#include "MemoryTracker.hpp"
+
+#include <algorithm>
+
+MemoryTracker::MemoryTracker() :
+  m_totalBytes(0),
+  m_peakTotalBytes(0)
+{
+  m_currentBytes.fill(0);
+  m_peakBytes.fill(0);
+}
+
+void MemoryTracker::Allocate(MemoryCategory category, UInt64 bytes)
+{
+  size_t index = static_cast<size_t>(category);
+  m_currentBytes[index] += bytes;
+  m_peakBytes[index] = std::max(m_peakBytes[index], m_currentBytes[index]);
+
+  m_totalBytes += bytes;
+  m_peakTotalBytes = std::max(m_peakTotalBytes, m_totalBytes);
+}
+
+void MemoryTracker::Release(MemoryCategory category, UInt64 bytes)
+{
+  // Never release more than was allocated, so mismatched estimates cannot underflow the totals
+  size_t index = static_cast<size_t>(category);
+  bytes = std::min(bytes, m_currentBytes[index]);
+  m_currentBytes[index] -= bytes;
+  m_totalBytes -= bytes;
+}
+
+UInt64 MemoryTracker::GetCurrentBytes() const
+{
+  return m_totalBytes;
+}
+
+UInt64 MemoryTracker::GetPeakBytes() const
+{
+  return m_peakTotalBytes;
+}
+
+UInt64 MemoryTracker::GetPeakBytes(MemoryCategory category) const
+{
+  return m_peakBytes[static_cast<size_t>(category)];
+}
+
+const char* MemoryTracker::GetCategoryName(MemoryCategory category)
+{
+  switch (category)
+  {
+  case MemoryCategory::ElementData:    return "elementData";
+  case MemoryCategory::PropertyValues: return "propertyValues";
+  case MemoryCategory::SerializedData: return "serializedData";
+  default:                             return "unknown";
+  }
+}
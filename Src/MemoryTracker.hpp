@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ACAPinc.h"
+
+#include <array>
+
+/**
+ * @brief The kinds of export data whose memory is accounted for
+ */
+enum class MemoryCategory
+{
+  ElementData,
+  PropertyValues,
+  SerializedData,
+  Count
+};
+
+/**
+ * @brief Accounts for the memory held by an export's element data and serialized buffers, keeping track of the
+ * current and peak usage. Sizes are estimates derived from the data, not measurements of the allocator.
+ */
+class MemoryTracker {
+public:
+  MemoryTracker();
+
+  void Allocate(MemoryCategory category, UInt64 bytes);
+  void Release(MemoryCategory category, UInt64 bytes);
+
+  UInt64 GetCurrentBytes() const;
+  UInt64 GetPeakBytes() const;
+  UInt64 GetPeakBytes(MemoryCategory category) const;
+
+  static const char* GetCategoryName(MemoryCategory category);
+
+private:
+  std::array<UInt64, static_cast<size_t>(MemoryCategory::Count)> m_currentBytes;
+  std::array<UInt64, static_cast<size_t>(MemoryCategory::Count)> m_peakBytes;
+  UInt64 m_totalBytes;
+  UInt64 m_peakTotalBytes;
+};
@@ -0,0 +1,43 @@
+#include "PropertyAllowList.hpp"
+
+const static USize GuidStringLength = 36;
+
+/**
+ * @brief Constructs an allow-list from property names and guids. Entries in guid format are matched against
+ * definition guids as well as names.
+ * @param[in] namesOrGuids Names or guid strings of the allowed property definitions
+ */
+PropertyAllowList::PropertyAllowList(const GS::Array<GS::UniString>& namesOrGuids)
+{
+  for (const GS::UniString& nameOrGuid : namesOrGuids)
+  {
+    if (nameOrGuid.IsEmpty())
+      continue;
+
+    m_names.Add(nameOrGuid);
+    if (nameOrGuid.GetLength() != GuidStringLength)
+      continue;
+
+    API_Guid guid = APIGuidFromString(nameOrGuid.ToCStr().Get());
+    if (guid != APINULLGuid)
+      m_guids.Add(APIGuid2GSGuid(guid));
+  }
+}
+
+bool PropertyAllowList::IsEmpty() const
+{
+  return m_names.IsEmpty();
+}
+
+/**
+ * @brief Determines if a property definition is allowed for export
+ * @param[in] definition The property definition to check
+ * @returns True if the allow-list is empty or contains the definition name or guid
+ */
+bool PropertyAllowList::Contains(const API_PropertyDefinition& definition) const
+{
+  if (IsEmpty())
+    return true;
+
+  return m_guids.Contains(APIGuid2GSGuid(definition.guid)) || m_names.Contains(definition.name);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ACAPinc.h"
+
+/**
+ * @brief Set of property definitions to export, matched by either definition name or guid. An empty allow-list
+ * places no restriction on the exported properties.
+ */
+class PropertyAllowList {
+public:
+  explicit PropertyAllowList(const GS::Array<GS::UniString>& namesOrGuids);
+
+  bool IsEmpty() const;
+  bool Contains(const API_PropertyDefinition& definition) const;
+
+private:
+  GS::HashSet<GS::UniString> m_names;
+  GS::HashSet<GS::Guid> m_guids;
+};
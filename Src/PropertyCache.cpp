@@ -0,0 +1,111 @@
+#include "PropertyCache.hpp"
+
+#include <cstring>
+
+PropertyCache::PropertyCache() :
+  m_maxMemorySize(0)
+{
+  // Cached elements are copied into the layers of each export, so the cache itself only needs a placeholder
+  m_store.AddLayer(GS::UniString());
+}
+
+/**
+ * @brief Obtains the cache shared by every export in the session
+ */
+PropertyCache& PropertyCache::GetSessionCache()
+{
+  static PropertyCache sessionCache;
+  return sessionCache;
+}
+
+/**
+ * @brief Copies the cached values of an element into a store, if they are still current
+ * @param[in] elemGuid The guid of the element
+ * @param[in] modiStamp The element's current modification stamp
+ * @param[in] definitionsHash The hash of the property definitions requested for the element
+ * @param[in] layerIndex The index of the element's layer in the store
+ * @param[out] store The store to copy the element into
+ * @returns True if the element was copied, otherwise its values must be fetched
+ */
+bool PropertyCache::CopyElement(const API_Guid& elemGuid, UInt64 modiStamp, UInt64 definitionsHash, UInt32 layerIndex, ElementStore& store) const
+{
+  auto it = m_entries.find(elemGuid);
+  if (it == m_entries.end() || it->second.modiStamp != modiStamp || it->second.definitionsHash != definitionsHash)
+    return false;
+
+  store.CopyElement(m_store, it->second.elemIndex, layerIndex);
+  return true;
+}
+
+/**
+ * @brief Caches the values of an element that have just been fetched, replacing any stale values. Nothing is
+ * cached once the cache is full.
+ * @param[in] modiStamp The element's modification stamp
+ * @param[in] definitionsHash The hash of the property definitions requested for the element
+ * @param[in] store The store holding the element's values
+ * @param[in] elemIndex The index of the element in the store
+ */
+void PropertyCache::AddElement(UInt64 modiStamp, UInt64 definitionsHash, const ElementStore& store, UInt32 elemIndex)
+{
+  if (m_store.GetMemorySize() >= m_maxMemorySize)
+  {
+    Compact();
+    if (m_store.GetMemorySize() >= m_maxMemorySize)
+      return;
+  }
+
+  m_entries[store.GetElementGuid(elemIndex)] = { modiStamp, definitionsHash, m_store.GetElementCount() };
+  m_store.CopyElement(store, elemIndex, 0);
+}
+
+/**
+ * @brief Limits the memory held by the cache, which is checked as elements are added
+ * @param[in] maxMemorySize The size in bytes
+ */
+void PropertyCache::SetMaxMemorySize(UInt64 maxMemorySize)
+{
+  m_maxMemorySize = maxMemorySize;
+}
+
+void PropertyCache::Clear()
+{
+  m_entries.clear();
+  m_store = ElementStore();
+  m_store.AddLayer(GS::UniString());
+}
+
+UInt32 PropertyCache::GetElementCount() const
+{
+  return static_cast<UInt32>(m_entries.size());
+}
+
+UInt64 PropertyCache::GetMemorySize() const
+{
+  return m_store.GetMemorySize();
+}
+
+size_t PropertyCache::GuidHasher::operator()(const API_Guid& guid) const
+{
+  // Guids are already well distributed, so their halves are simply combined
+  UInt64 halves[2];
+  static_assert(sizeof(halves) == sizeof(API_Guid), "API_Guid is expected to be 16 bytes");
+  std::memcpy(halves, &guid, sizeof(halves));
+  return static_cast<size_t>(halves[0] ^ (halves[1] * 31));
+}
+
+void PropertyCache::Compact()
+{
+  // Copy the current values of each element into a new store, leaving behind values that have since been replaced
+  if (m_entries.size() == m_store.GetElementCount())
+    return;
+
+  ElementStore store;
+  store.AddLayer(GS::UniString());
+  for (auto& entry : m_entries)
+  {
+    UInt32 elemIndex = store.GetElementCount();
+    store.CopyElement(m_store, entry.second.elemIndex, 0);
+    entry.second.elemIndex = elemIndex;
+  }
+  m_store = std::move(store);
+}
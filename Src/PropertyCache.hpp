@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ACAPinc.h"
+#include "ElementStore.hpp"
+
+#include <unordered_map>
+
+/**
+ * @brief Property values of exported elements, kept between exports for the rest of the session. Values are
+ * reused for as long as the element's modification stamp and the hash of the definitions requested for it are
+ * unchanged, so repeated exports of a mostly unchanged model only fetch values for modified elements. Values are
+ * held in a compact element store, which is rebuilt without its replaced values when it fills up.
+ */
+class PropertyCache {
+public:
+  PropertyCache();
+
+  static PropertyCache& GetSessionCache();
+
+  bool CopyElement(const API_Guid& elemGuid, UInt64 modiStamp, UInt64 definitionsHash, UInt32 layerIndex, ElementStore& store) const;
+  void AddElement(UInt64 modiStamp, UInt64 definitionsHash, const ElementStore& store, UInt32 elemIndex);
+  void SetMaxMemorySize(UInt64 maxMemorySize);
+  void Clear();
+
+  UInt32 GetElementCount() const;
+  UInt64 GetMemorySize() const;
+
+private:
+  struct Entry
+  {
+    UInt64 modiStamp;
+    UInt64 definitionsHash;
+    UInt32 elemIndex;
+  };
+
+  struct GuidHasher
+  {
+    size_t operator()(const API_Guid& guid) const;
+  };
+
+  void Compact();
+
+  std::unordered_map<API_Guid, Entry, GuidHasher> m_entries;
+  ElementStore m_store;
+  UInt64 m_maxMemorySize;
+};
@@ -0,0 +1,341 @@
+#include "QueryServer.hpp"
+#include "ContentHash.hpp"
+#include "JsonWriter.hpp"
+
+#include "Thirdparty/httplib.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+
+namespace {
+
+// The server only accepts connections from the local machine
+const char* ServerHost = "127.0.0.1";
+const char* JsonContentType = "application/json";
+
+// Pages of elements are streamed in chunks of this many elements
+const size_t StreamGroupSize = 64;
+
+/**
+ * @brief A page of elements being streamed, holding on to the snapshot they were found in
+ */
+struct ElementPage
+{
+  ElementPage() :
+    next(0),
+    end(0),
+    writer(-1)
+  {
+  }
+
+  std::shared_ptr<const QuerySnapshot> snapshot;
+  std::vector<std::uint32_t> elemIndices;
+  std::vector<bool> nameMask;
+  size_t next;
+  size_t end;
+  JsonWriter writer;
+};
+
+void GetParamValues(const httplib::Request& request, const std::string& key, std::vector<std::string>& values)
+{
+  for (size_t i = 0; i < request.get_param_value_count(key); ++i)
+    values.push_back(request.get_param_value(key, i));
+}
+
+bool GetSizeParam(const httplib::Request& request, const std::string& key, size_t defaultValue, size_t& value)
+{
+  value = defaultValue;
+  if (!request.has_param(key))
+    return true;
+
+  std::string text = request.get_param_value(key);
+  std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+  return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+void SetError(int status, const std::string& message, httplib::Response& response)
+{
+  JsonWriter writer(-1);
+  writer.BeginObject();
+  writer.WriteKey("\"error\"");
+  writer.WriteString(message);
+  writer.EndObject();
+  response.status = status;
+  response.set_content(writer.TakeBuffer(), JsonContentType);
+}
+
+bool IsLocalHost(const std::string& host)
+{
+  // Accept the names of the local machine only, with or without a port
+  size_t nameEnd = host.find(':');
+  std::string name = host.substr(0, nameEnd);
+  if (nameEnd != std::string::npos)
+  {
+    std::string port = host.substr(nameEnd + 1);
+    if (port.empty() || port.find_first_not_of("0123456789") != std::string::npos)
+      return false;
+  }
+  std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c)
+  {
+    return static_cast<char>(std::tolower(c));
+  });
+  return name == "localhost" || name == "127.0.0.1";
+}
+
+bool IsNotModified(std::uint64_t snapshotTag, const httplib::Request& request, httplib::Response& response)
+{
+  // The same request of the same snapshot always has the same response, so the tag is derived from both
+  ContentHash hash;
+  hash.Append(&snapshotTag, sizeof(snapshotTag));
+  hash.Append(request.path.data(), request.path.size() + 1);
+  for (const auto& param : request.params)
+  {
+    hash.Append(param.first.data(), param.first.size() + 1);
+    hash.Append(param.second.data(), param.second.size() + 1);
+  }
+
+  char etag[24];
+  std::snprintf(etag, sizeof(etag), "\"%016llx\"", static_cast<unsigned long long>(hash.GetValue()));
+  response.set_header("ETag", etag);
+  response.set_header("Cache-Control", "no-cache");
+
+  std::string ifNoneMatch = request.get_header_value("If-None-Match");
+  if (ifNoneMatch == "*" || ifNoneMatch.find(etag) != std::string::npos)
+  {
+    response.status = httplib::StatusCode::NotModified_304;
+    return true;
+  }
+  return false;
+}
+
+}
+
+QueryServer::QueryServer() :
+  m_port(0)
+{
+}
+
+QueryServer::~QueryServer()
+{
+  Stop();
+}
+
+/**
+ * @brief Obtains the server shared by every export in the session
+ */
+QueryServer& QueryServer::GetSessionServer()
+{
+  static QueryServer sessionServer;
+  return sessionServer;
+}
+
+/**
+ * @brief Starts listening for requests on a local port, on a thread of the server's own. A server already listening
+ * on a different port is restarted on the new one.
+ * @param[in] port The port to listen on, or 0 to listen on any free port
+ * @param[out] errorStr Error message output if the server could not be started
+ * @returns True if the server is listening on the port
+ */
+bool QueryServer::Start(std::uint32_t port, std::string& errorStr)
+{
+  if (IsRunning() && (m_port == port || port == 0))
+    return true;
+  Stop();
+
+  m_server = std::make_unique<httplib::Server>();
+  m_server->set_pre_routing_handler([](const httplib::Request& request, httplib::Response& response)
+  {
+    if (IsLocalHost(request.get_header_value("Host")))
+      return httplib::Server::HandlerResponse::Unhandled;
+
+    SetError(httplib::StatusCode::Forbidden_403, "Requests must be made to localhost or 127.0.0.1", response);
+    return httplib::Server::HandlerResponse::Handled;
+  });
+  m_server->Get("/types", [this](const httplib::Request& request, httplib::Response& response)
+  {
+    HandleTypes(request, response);
+  });
+  m_server->Get("/layers", [this](const httplib::Request& request, httplib::Response& response)
+  {
+    HandleLayers(request, response);
+  });
+  m_server->Get("/elements", [this](const httplib::Request& request, httplib::Response& response)
+  {
+    HandleElements(request, response);
+  });
+
+  int boundPort = static_cast<int>(port);
+  if (port == 0)
+    boundPort = m_server->bind_to_any_port(ServerHost);
+  else if (!m_server->bind_to_port(ServerHost, boundPort))
+    boundPort = -1;
+  if (boundPort <= 0)
+  {
+    errorStr = "Unable to listen on port " + std::to_string(port);
+    m_server.reset();
+    return false;
+  }
+
+  // Wait for the server to start listening, so that it can always be stopped
+  m_port = static_cast<std::uint32_t>(boundPort);
+  m_thread = std::thread([this]()
+  {
+    m_server->listen_after_bind();
+  });
+  m_server->wait_until_ready();
+  return true;
+}
+
+/**
+ * @brief Stops the server, waiting for requests in progress to finish. The published snapshot is kept.
+ */
+void QueryServer::Stop()
+{
+  if (m_server == nullptr)
+    return;
+
+  m_server->stop();
+  if (m_thread.joinable())
+    m_thread.join();
+  m_server.reset();
+}
+
+bool QueryServer::IsRunning() const
+{
+  return m_server != nullptr;
+}
+
+std::uint32_t QueryServer::GetPort() const
+{
+  return m_port;
+}
+
+/**
+ * @brief Replaces the snapshot requests are answered from. Requests in progress finish with the snapshot they
+ * started with.
+ * @param[in] snapshot The new snapshot
+ */
+void QueryServer::Publish(std::shared_ptr<const QuerySnapshot> snapshot)
+{
+  std::lock_guard<std::mutex> lock(m_snapshotMutex);
+  m_snapshot = std::move(snapshot);
+}
+
+std::shared_ptr<const QuerySnapshot> QueryServer::GetSnapshot() const
+{
+  std::lock_guard<std::mutex> lock(m_snapshotMutex);
+  return m_snapshot;
+}
+
+void QueryServer::HandleTypes(const httplib::Request& request, httplib::Response& response) const
+{
+  std::shared_ptr<const QuerySnapshot> snapshot = GetSnapshot();
+  if (snapshot == nullptr)
+  {
+    SetError(httplib::StatusCode::ServiceUnavailable_503, "No elements have been exported to the server yet", response);
+    return;
+  }
+  if (IsNotModified(snapshot->GetTag(), request, response))
+    return;
+
+  JsonWriter writer(-1);
+  writer.BeginObject();
+  writer.WriteKey("\"types\"");
+  snapshot->WriteTypes(writer);
+  writer.EndObject();
+  response.set_content(writer.TakeBuffer(), JsonContentType);
+}
+
+void QueryServer::HandleLayers(const httplib::Request& request, httplib::Response& response) const
+{
+  std::shared_ptr<const QuerySnapshot> snapshot = GetSnapshot();
+  if (snapshot == nullptr)
+  {
+    SetError(httplib::StatusCode::ServiceUnavailable_503, "No elements have been exported to the server yet", response);
+    return;
+  }
+  if (IsNotModified(snapshot->GetTag(), request, response))
+    return;
+
+  JsonWriter writer(-1);
+  writer.BeginObject();
+  writer.WriteKey("\"layers\"");
+  snapshot->WriteLayers(writer);
+  writer.EndObject();
+  response.set_content(writer.TakeBuffer(), JsonContentType);
+}
+
+void QueryServer::HandleElements(const httplib::Request& request, httplib::Response& response) const
+{
+  std::shared_ptr<const QuerySnapshot> snapshot = GetSnapshot();
+  if (snapshot == nullptr)
+  {
+    SetError(httplib::StatusCode::ServiceUnavailable_503, "No elements have been exported to the server yet", response);
+    return;
+  }
+
+  size_t offset;
+  size_t limit;
+  if (!GetSizeParam(request, "offset", 0, offset) || !GetSizeParam(request, "limit", DefaultPageSize, limit) || limit == 0)
+  {
+    SetError(httplib::StatusCode::BadRequest_400, "offset and limit must be whole numbers, with a limit of at least 1", response);
+    return;
+  }
+  limit = std::min(limit, MaxPageSize);
+
+  if (IsNotModified(snapshot->GetTag(), request, response))
+    return;
+
+  QuerySnapshot::Query query;
+  GetParamValues(request, "type", query.elemTypeNames);
+  GetParamValues(request, "layer", query.layerNames);
+  GetParamValues(request, "props", query.propertyNames);
+
+  std::shared_ptr<ElementPage> page = std::make_shared<ElementPage>();
+  page->snapshot = snapshot;
+  snapshot->FindElements(query, page->elemIndices);
+  snapshot->GetPropertyMask(query, page->nameMask);
+  page->next = std::min(offset, page->elemIndices.size());
+  page->end = std::min(page->next + limit, page->elemIndices.size());
+
+  // The page header is known up front, and is followed by the elements as they are written
+  JsonWriter& writer = page->writer;
+  writer.SetRealDecimalPlaces(snapshot->GetRealDecimalPlaces());
+  writer.BeginObject();
+  writer.WriteKey("\"total\"");
+  writer.WriteInt(static_cast<int>(page->elemIndices.size()));
+  writer.WriteKey("\"offset\"");
+  writer.WriteInt(static_cast<int>(page->next));
+  writer.WriteKey("\"limit\"");
+  writer.WriteInt(static_cast<int>(limit));
+  if (page->end < page->elemIndices.size())
+  {
+    writer.WriteKey("\"nextOffset\"");
+    writer.WriteInt(static_cast<int>(page->end));
+  }
+  writer.WriteKey("\"elements\"");
+  writer.BeginArray();
+
+  response.set_chunked_content_provider(JsonContentType, [page](size_t, httplib::DataSink& sink)
+  {
+    size_t groupEnd = std::min(page->next + StreamGroupSize, page->end);
+    for (; page->next < groupEnd; ++page->next)
+      page->snapshot->WriteElement(page->elemIndices[page->next], page->nameMask, page->writer);
+
+    bool isLastChunk = page->next == page->end;
+    if (isLastChunk)
+    {
+      page->writer.EndArray();
+      page->writer.EndObject();
+    }
+
+    std::string chunk = page->writer.FlushBuffer();
+    if (!sink.write(chunk.data(), chunk.size()))
+      return false;
+    if (isLastChunk)
+      sink.done();
+    return true;
+  });
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "QuerySnapshot.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace httplib {
+class Server;
+struct Request;
+struct Response;
+}
+
+/**
+ * @brief Local http server answering queries for element data from the latest published snapshot, so that tools can
+ * pull the elements and properties they need without running an export. Requests are served on the server's own
+ * threads and never call the Archicad API, as snapshots are built on the API thread and swapped in whole. Responses
+ * carry an ETag derived from the snapshot's tag and the request, and element pages are streamed in chunks. Requests
+ * naming any host other than the local machine are refused, so that web pages cannot reach the server by rebinding
+ * their own host name to it.
+ */
+class QueryServer {
+public:
+  static const size_t DefaultPageSize = 100;
+  static const size_t MaxPageSize = 10000;
+
+  QueryServer();
+  ~QueryServer();
+
+  static QueryServer& GetSessionServer();
+
+  bool Start(std::uint32_t port, std::string& errorStr);
+  void Stop();
+  bool IsRunning() const;
+  std::uint32_t GetPort() const;
+
+  void Publish(std::shared_ptr<const QuerySnapshot> snapshot);
+  std::shared_ptr<const QuerySnapshot> GetSnapshot() const;
+
+private:
+  void HandleTypes(const httplib::Request& request, httplib::Response& response) const;
+  void HandleLayers(const httplib::Request& request, httplib::Response& response) const;
+  void HandleElements(const httplib::Request& request, httplib::Response& response) const;
+
+  std::unique_ptr<httplib::Server> m_server;
+  std::thread m_thread;
+  std::uint32_t m_port;
+
+  mutable std::mutex m_snapshotMutex;
+  std::shared_ptr<const QuerySnapshot> m_snapshot;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JsonWriter;
+
+/**
+ * @brief The element data the query server answers requests from. A snapshot must not change once published, as
+ * requests are answered from it on the server's threads. Implementations must not call the Archicad API, and the
+ * interface uses no API types, so that the server can be run against a synthetic snapshot where the API is missing.
+ */
+class QuerySnapshot {
+public:
+  /**
+   * @brief The names of the element types, layers and properties a request is limited to. An empty list of names
+   * does not limit the request.
+   */
+  struct Query
+  {
+    std::vector<std::string> elemTypeNames;
+    std::vector<std::string> layerNames;
+    std::vector<std::string> propertyNames;
+  };
+
+  virtual ~QuerySnapshot() = default;
+
+  virtual std::uint64_t GetTag() const = 0;
+  virtual std::int32_t GetRealDecimalPlaces() const = 0;
+
+  virtual void FindElements(const Query& query, std::vector<std::uint32_t>& elemIndices) const = 0;
+  virtual void GetPropertyMask(const Query& query, std::vector<bool>& nameMask) const = 0;
+  virtual void WriteElement(std::uint32_t elemIndex, const std::vector<bool>& nameMask, JsonWriter& writer) const = 0;
+  virtual void WriteTypes(JsonWriter& writer) const = 0;
+  virtual void WriteLayers(JsonWriter& writer) const = 0;
+};
@@ -0,0 +1,74 @@
+#include "StringTable.hpp"
+#include "Utf8Transcoder.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+/**
+ * @brief Obtains the id for a string, adding it to the table if not already present
+ * @param[in] str The string to intern
+ * @returns The id of the interned string
+ */
+UInt32 StringTable::Intern(const GS::UniString& str)
+{
+  const UInt32* existingId = m_ids.GetPtr(str);
+  if (existingId != nullptr)
+    return *existingId;
+
+  // Encode and escape the string once, all later lookups reuse these bytes
+  size_t textOffset = m_textBytes.size();
+  Utf8Transcoder::Append(m_textBytes, str);
+  m_texts.push_back({ textOffset, m_textBytes.size() - textOffset });
+
+  size_t keyOffset = m_keyBytes.size();
+  m_keyBytes.push_back('"');
+  Utf8Transcoder::AppendEscaped(m_keyBytes, str);
+  m_keyBytes.push_back('"');
+  m_keys.push_back({ keyOffset, m_keyBytes.size() - keyOffset });
+
+  UInt32 id = static_cast<UInt32>(m_texts.size() - 1);
+  m_ids.Add(str, id);
+  return id;
+}
+
+/**
+ * @brief Obtains the UTF-8 text of an interned string. The view is invalidated by further calls to Intern.
+ * @param[in] id The id of the interned string
+ */
+std::string_view StringTable::GetText(UInt32 id) const
+{
+  const Span& span = m_texts[id];
+  return std::string_view(m_textBytes.data() + span.offset, span.length);
+}
+
+/**
+ * @brief Obtains the quoted and escaped JSON key of an interned string. The view is invalidated by further calls
+ * to Intern.
+ * @param[in] id The id of the interned string
+ */
+std::string_view StringTable::GetKey(UInt32 id) const
+{
+  const Span& span = m_keys[id];
+  return std::string_view(m_keyBytes.data() + span.offset, span.length);
+}
+
+UInt32 StringTable::GetSize() const
+{
+  return static_cast<UInt32>(m_texts.size());
+}
+
+/**
+ * @brief Computes the position of each interned string when sorted bytewise, which is the key order used by JSON
+ * objects. Comparing ranks is then equivalent to comparing the strings themselves.
+ * @param[out] ranks The sort rank of each string, indexed by id
+ */
+void StringTable::GetSortRanks(std::vector<UInt32>& ranks) const
+{
+  std::vector<UInt32> sortedIds(m_texts.size());
+  std::iota(sortedIds.begin(), sortedIds.end(), 0);
+  std::sort(sortedIds.begin(), sortedIds.end(), [this](UInt32 a, UInt32 b) { return GetText(a) < GetText(b); });
+
+  ranks.resize(sortedIds.size());
+  for (UInt32 rank = 0; rank < sortedIds.size(); ++rank)
+    ranks[sortedIds[rank]] = rank;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ACAPinc.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Interns strings such as layer, type and property names once per export. Each interned string is
+ * stored both as plain UTF-8 text and as a quoted, escaped JSON key so writers can copy the key bytes directly.
+ */
+class StringTable {
+public:
+  UInt32 Intern(const GS::UniString& str);
+
+  std::string_view GetText(UInt32 id) const;
+  std::string_view GetKey(UInt32 id) const;
+  UInt32 GetSize() const;
+
+  void GetSortRanks(std::vector<UInt32>& ranks) const;
+
+private:
+  struct Span
+  {
+    size_t offset;
+    size_t length;
+  };
+
+  GS::HashTable<GS::UniString, UInt32> m_ids;
+  std::string m_textBytes;
+  std::string m_keyBytes;
+  std::vector<Span> m_texts;
+  std::vector<Span> m_keys;
+};
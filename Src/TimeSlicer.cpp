@@ -0,0 +1,52 @@
+#include "TimeSlicer.hpp"
+
+#include <algorithm>
+#include <utility>
+
+/**
+ * @param[in] sliceDuration The time each slice is to take at most
+ * @param[in] maxStepSize The most items run in one step
+ * @param[in] clock Gives the current time, or null to use the steady clock. Tests pass a clock of their own, so
+ * that slices are timed exactly.
+ */
+TimeSlicer::TimeSlicer(std::chrono::steady_clock::duration sliceDuration, USize maxStepSize, Clock clock) :
+  m_sliceDuration(sliceDuration),
+  m_maxStepSize(std::max<USize>(maxStepSize, 1)),
+  m_itemDuration(std::chrono::steady_clock::duration::zero()),
+  m_clock(clock != nullptr ? std::move(clock) : []() { return std::chrono::steady_clock::now(); })
+{
+}
+
+/**
+ * @brief Runs steps until the slice is used up or there is no more work
+ * @param[in] step Runs up to the given number of items, returning true if there is more work to do
+ * @returns True if there is more work to do
+ */
+bool TimeSlicer::RunSlice(const Step& step)
+{
+  std::chrono::steady_clock::time_point start = m_clock();
+  bool isFirstStep = true;
+  bool isMoreWork = true;
+  while (isMoreWork)
+  {
+    // Run a single item until its time is known, and stop once not even one more item is expected to fit
+    std::chrono::steady_clock::duration remaining = m_sliceDuration - (m_clock() - start);
+    USize itemCount = 1;
+    if (m_itemDuration > std::chrono::steady_clock::duration::zero())
+    {
+      if (!isFirstStep && remaining < m_itemDuration)
+        break;
+      itemCount = static_cast<USize>(std::clamp<std::chrono::steady_clock::rep>(remaining / 2 / m_itemDuration, 1, m_maxStepSize));
+    }
+
+    std::chrono::steady_clock::time_point stepStart = m_clock();
+    isMoreWork = step(itemCount);
+    isFirstStep = false;
+
+    // Follow slower items at once, but let the estimate fall only by half a step at a time, so that a step that
+    // happens to be fast does not oversize the next one
+    std::chrono::steady_clock::duration itemDuration = (m_clock() - stepStart) / itemCount;
+    m_itemDuration = std::max(std::max(itemDuration, m_itemDuration / 2), std::chrono::steady_clock::duration(1));
+  }
+  return isMoreWork;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ACAPinc.h"
+
+#include <chrono>
+#include <functional>
+
+/**
+ * @brief Runs work in slices of time, each made of steps over a number of items. The time an item takes is
+ * estimated from the steps already run, and each step is sized to fill half of the time left in the slice, so that
+ * a slice stops short of its duration rather than running past it. A slice overruns only if items become much slower
+ * than estimated, and then by about the time of one item. Every slice runs at least one item, so work whose items
+ * are longer than a slice still progresses. Time is read from the steady clock, unless another clock is given.
+ */
+class TimeSlicer {
+public:
+  using Step = std::function<bool(USize itemCount)>;
+  using Clock = std::function<std::chrono::steady_clock::time_point()>;
+
+  TimeSlicer(std::chrono::steady_clock::duration sliceDuration, USize maxStepSize, Clock clock = nullptr);
+
+  bool RunSlice(const Step& step);
+
+private:
+  std::chrono::steady_clock::duration m_sliceDuration;
+  USize m_maxStepSize;
+  std::chrono::steady_clock::duration m_itemDuration;
+  Clock m_clock;
+};
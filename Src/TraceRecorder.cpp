@@ -0,0 +1,139 @@
+#include "TraceRecorder.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct TraceEvent
+{
+  const char* name;
+  const char* category;
+  const char* argName;
+  Int64 argValue;
+  UInt32 threadId;
+  double startMicroseconds;
+  double durationMicroseconds;
+};
+
+std::atomic<bool> s_isEnabled(false);
+std::atomic<UInt32> s_nextThreadId(1);
+std::mutex s_eventsMutex;
+std::vector<TraceEvent> s_events;
+std::chrono::steady_clock::time_point s_origin;
+
+UInt32 GetCurrentThreadId()
+{
+  // Threads are numbered in the order they first record a span, which keeps ids small and stable within a trace
+  thread_local UInt32 threadId = s_nextThreadId++;
+  return threadId;
+}
+
+}
+
+/**
+ * @brief Starts timing a span. The name, category and argument name must be string literals or otherwise
+ * outlive the recording.
+ * @param[in] name The name of the span
+ * @param[in] category The category of the span, used to filter spans in the trace viewer
+ */
+TraceRecorder::ScopedSpan::ScopedSpan(const char* name, const char* category) :
+  m_name(name),
+  m_category(category),
+  m_argName(nullptr),
+  m_argValue(0),
+  m_isRecording(s_isEnabled.load(std::memory_order_relaxed))
+{
+  if (m_isRecording)
+    m_start = std::chrono::steady_clock::now();
+}
+
+TraceRecorder::ScopedSpan::~ScopedSpan()
+{
+  Stop();
+}
+
+/**
+ * @brief Attaches a numeric argument to the span, e.g. the number of elements or bytes it processed
+ * @param[in] argName The name of the argument
+ * @param[in] argValue The value of the argument
+ */
+void TraceRecorder::ScopedSpan::SetArg(const char* argName, Int64 argValue)
+{
+  m_argName = argName;
+  m_argValue = argValue;
+}
+
+/**
+ * @brief Ends the span before the scope exits. Further calls have no effect.
+ */
+void TraceRecorder::ScopedSpan::Stop()
+{
+  if (!m_isRecording)
+    return;
+  m_isRecording = false;
+
+  if (!IsEnabled())
+    return;
+
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  std::lock_guard<std::mutex> lock(s_eventsMutex);
+  std::chrono::duration<double, std::micro> start = m_start - s_origin;
+  std::chrono::duration<double, std::micro> duration = end - m_start;
+  s_events.push_back({ m_name, m_category, m_argName, m_argValue, GetCurrentThreadId(), start.count(), duration.count() });
+}
+
+/**
+ * @brief Discards any previously recorded spans and starts recording new ones
+ */
+void TraceRecorder::Start()
+{
+  std::lock_guard<std::mutex> lock(s_eventsMutex);
+  s_events.clear();
+  s_origin = std::chrono::steady_clock::now();
+  s_isEnabled = true;
+}
+
+/**
+ * @brief Stops recording spans. Spans that are still open when recording stops are not recorded.
+ */
+void TraceRecorder::Stop()
+{
+  s_isEnabled = false;
+}
+
+bool TraceRecorder::IsEnabled()
+{
+  return s_isEnabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Converts the recorded spans into a Chrome trace_event json object, with each span as a complete event
+ * @returns The trace json
+ */
+json TraceRecorder::ToJson()
+{
+  std::lock_guard<std::mutex> lock(s_eventsMutex);
+
+  json traceEvents = json::array();
+  for (const TraceEvent& event : s_events)
+  {
+    json traceEvent = {
+      { "name", event.name },
+      { "cat", event.category },
+      { "ph", "X" },
+      { "ts", event.startMicroseconds },
+      { "dur", event.durationMicroseconds },
+      { "pid", 1 },
+      { "tid", event.threadId }
+    };
+    if (event.argName != nullptr)
+      traceEvent["args"] = { { event.argName, event.argValue } };
+
+    traceEvents.push_back(traceEvent);
+  }
+
+  return { { "traceEvents", traceEvents }, { "displayTimeUnit", "ms" } };
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ACAPinc.h"
+#include "Thirdparty/json.hpp"
+
+#include <chrono>
+
+using json = nlohmann::json;
+
+/**
+ * @brief Records timed spans of the export pipeline from any thread, which can be written out in the Chrome
+ * trace_event format and loaded into Perfetto or chrome://tracing. Recording is off by default, in which case
+ * spans cost a single relaxed atomic load.
+ */
+class TraceRecorder {
+public:
+  TraceRecorder() = delete; // prevent instantiation of this class
+
+  /**
+   * @brief Records the time between construction and destruction (or Stop) as a span, if recording is enabled
+   */
+  class ScopedSpan {
+  public:
+    ScopedSpan(const char* name, const char* category);
+    ~ScopedSpan();
+
+    void SetArg(const char* argName, Int64 argValue);
+    void Stop();
+
+  private:
+    const char* m_name;
+    const char* m_category;
+    const char* m_argName;
+    Int64 m_argValue;
+    std::chrono::steady_clock::time_point m_start;
+    bool m_isRecording;
+  };
+
+  static void Start();
+  static void Stop();
+  static bool IsEnabled();
+
+  static json ToJson();
+};
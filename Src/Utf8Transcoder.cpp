@@ -0,0 +1,229 @@
+#include "Utf8Transcoder.hpp"
+#include "CpuFeatures.hpp"
+
+#include <cstring>
+
+#ifdef EXPORT_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef EXPORT_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+typedef GS::UniChar::Layout Unit;
+
+// The most bytes a single UTF-16 unit can produce, e.g. \u001f when escaping control characters
+const size_t MaxEncodedUnitBytes = 3;
+const size_t MaxEscapedUnitBytes = 6;
+
+// The fewest characters encoded one at a time after a vector copy stops
+const size_t MinScalarUnits = 16;
+
+bool NeedsEscape(UInt32 unit)
+{
+  return unit < 0x20 || unit == '"' || unit == '\\';
+}
+
+bool IsCopiedAsIs(UInt32 unit, bool isEscaped)
+{
+  return unit < 0x80 && !(isEscaped && NeedsEscape(unit));
+}
+
+char* WriteEscape(char* output, UInt32 unit)
+{
+  // Use the same escapes as nlohmann::json and JsonWriter::AppendEscaped
+  static const char HexDigits[] = "0123456789abcdef";
+
+  *output++ = '\\';
+  switch (unit)
+  {
+  case '"':  *output++ = '"'; break;
+  case '\\': *output++ = '\\'; break;
+  case '\b': *output++ = 'b'; break;
+  case '\f': *output++ = 'f'; break;
+  case '\n': *output++ = 'n'; break;
+  case '\r': *output++ = 'r'; break;
+  case '\t': *output++ = 't'; break;
+  default:
+    std::memcpy(output, "u00", 3);
+    output[3] = HexDigits[unit >> 4];
+    output[4] = HexDigits[unit & 0x0F];
+    output += 5;
+    break;
+  }
+  return output;
+}
+
+#ifdef EXPORT_SIMD_SSE2
+
+size_t CopyAsciiSse2(const Unit* units, size_t length, bool isEscaped, char* output)
+{
+  const __m128i nonAsciiBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+  const __m128i firstPrintable = _mm_set1_epi16(0x20);
+  const __m128i quote = _mm_set1_epi16('"');
+  const __m128i backslash = _mm_set1_epi16('\\');
+
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8)
+  {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(units + i));
+    __m128i isCopied = _mm_cmpeq_epi16(_mm_and_si128(block, nonAsciiBits), _mm_setzero_si128());
+    if (isEscaped)
+    {
+      __m128i isEscapedChar = _mm_or_si128(_mm_cmplt_epi16(block, firstPrintable), _mm_or_si128(_mm_cmpeq_epi16(block, quote), _mm_cmpeq_epi16(block, backslash)));
+      isCopied = _mm_andnot_si128(isEscapedChar, isCopied);
+    }
+
+    // Narrow the units to bytes and store them all, then stop after the last one that could be copied as-is
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(block, block));
+    unsigned int copiedMask = static_cast<unsigned int>(_mm_movemask_epi8(isCopied));
+    if (copiedMask != 0xFFFF)
+      return i + CpuFeatures::CountTrailingZeros(~copiedMask) / 2;
+  }
+  return i;
+}
+
+#endif
+
+#ifdef EXPORT_SIMD_AVX2
+
+EXPORT_TARGET_AVX2 size_t CopyAsciiAvx2(const Unit* units, size_t length, bool isEscaped, char* output)
+{
+  const __m256i nonAsciiBits = _mm256_set1_epi16(static_cast<short>(0xFF80));
+  const __m256i firstPrintable = _mm256_set1_epi16(0x20);
+  const __m256i quote = _mm256_set1_epi16('"');
+  const __m256i backslash = _mm256_set1_epi16('\\');
+
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16)
+  {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(units + i));
+    __m256i isCopied = _mm256_cmpeq_epi16(_mm256_and_si256(block, nonAsciiBits), _mm256_setzero_si256());
+    if (isEscaped)
+    {
+      __m256i isEscapedChar = _mm256_or_si256(_mm256_cmpgt_epi16(firstPrintable, block), _mm256_or_si256(_mm256_cmpeq_epi16(block, quote), _mm256_cmpeq_epi16(block, backslash)));
+      isCopied = _mm256_andnot_si256(isEscapedChar, isCopied);
+    }
+
+    // Packing works within each 128-bit lane, so the packed halves are gathered into the low lane
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(block, block), 0xD8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm256_castsi256_si128(packed));
+    unsigned int copiedMask = static_cast<unsigned int>(_mm256_movemask_epi8(isCopied));
+    if (copiedMask != 0xFFFFFFFF)
+      return i + CpuFeatures::CountTrailingZeros(~copiedMask) / 2;
+  }
+
+  // Remaining characters are left to the caller, as switching to SSE code here would incur AVX transition penalties
+  return i;
+}
+
+#endif
+
+/**
+ * @brief Copies the leading run of ASCII characters that need no escaping, a vector at a time. May write up to a
+ * vector's width of bytes past the end of the run, which the output buffer must have room for.
+ * @returns The length of the run, which is 0 without vector support
+ */
+size_t CopyAscii(const Unit* units, size_t length, bool isEscaped, char* output)
+{
+#ifdef EXPORT_SIMD_AVX2
+  if (CpuFeatures::HasAvx2())
+    return CopyAsciiAvx2(units, length, isEscaped, output);
+#endif
+#ifdef EXPORT_SIMD_SSE2
+  return CopyAsciiSse2(units, length, isEscaped, output);
+#else
+  return 0;
+#endif
+}
+
+size_t Transcode(const Unit* units, size_t length, bool isEscaped, char* output)
+{
+  char* out = output;
+  size_t i = 0;
+  while (i < length)
+  {
+    size_t runLength = CopyAscii(units + i, length - i, isEscaped, out);
+    i += runLength;
+    out += runLength;
+
+    // Encode characters one at a time, up to the next one that can start a vector copy. A minimum number are encoded
+    // first, so that text mixing short ASCII runs with other characters is not slowed by failing vector copies.
+    size_t minScalarEnd = i + MinScalarUnits;
+    while (i < length)
+    {
+      UInt32 unit = static_cast<UInt32>(units[i++]);
+      if (unit < 0x80)
+      {
+        if (isEscaped && NeedsEscape(unit))
+          out = WriteEscape(out, unit);
+        else
+          *out++ = static_cast<char>(unit);
+      }
+      else if (unit < 0x800)
+      {
+        *out++ = static_cast<char>(0xC0 | (unit >> 6));
+        *out++ = static_cast<char>(0x80 | (unit & 0x3F));
+      }
+      else if (unit >= 0xD800 && unit < 0xDC00 && i < length && units[i] >= 0xDC00 && units[i] < 0xE000)
+      {
+        // Combine surrogate pairs into a single four byte sequence
+        UInt32 codePoint = 0x10000 + ((unit - 0xD800) << 10) + (static_cast<UInt32>(units[i++]) - 0xDC00);
+        *out++ = static_cast<char>(0xF0 | (codePoint >> 18));
+        *out++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        *out++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+      }
+      else
+      {
+        if (unit >= 0xD800 && unit < 0xE000)
+          unit = 0xFFFD;
+
+        *out++ = static_cast<char>(0xE0 | (unit >> 12));
+        *out++ = static_cast<char>(0x80 | ((unit >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (unit & 0x3F));
+      }
+
+      if (i >= minScalarEnd && i < length && IsCopiedAsIs(static_cast<UInt32>(units[i]), isEscaped))
+        break;
+    }
+  }
+  return static_cast<size_t>(out - output);
+}
+
+}
+
+/**
+ * @brief Appends a string to the output as UTF-8
+ * @param[out] output The buffer to append to
+ * @param[in] str The string to convert
+ */
+void Utf8Transcoder::Append(std::string& output, const GS::UniString& str)
+{
+  AppendUnits(output, str, false);
+}
+
+/**
+ * @brief Appends a string to the output as UTF-8 with JSON escaping applied, giving the same bytes as converting
+ * the string and then escaping it with JsonWriter::AppendEscaped. Quotes are not added.
+ * @param[out] output The buffer to append to
+ * @param[in] str The string to convert
+ */
+void Utf8Transcoder::AppendEscaped(std::string& output, const GS::UniString& str)
+{
+  AppendUnits(output, str, true);
+}
+
+void Utf8Transcoder::AppendUnits(std::string& output, const GS::UniString& str, bool isEscaped)
+{
+  auto unitBuffer = str.ToUStr();
+  const Unit* units = unitBuffer;
+  size_t length = str.GetLength();
+
+  // Make room for the longest possible output, then trim to what was written
+  size_t offset = output.size();
+  output.resize(offset + length * (isEscaped ? MaxEscapedUnitBytes : MaxEncodedUnitBytes));
+  output.resize(offset + Transcode(units, length, isEscaped, &output[offset]));
+}
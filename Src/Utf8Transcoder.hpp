@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ACAPinc.h"
+
+#include <string>
+
+/**
+ * @brief Converts UTF-16 strings to UTF-8 in a single pass, appending straight to an output buffer rather than
+ * going through an intermediate string. Runs of ASCII characters are copied a vector at a time where SSE2 or
+ * AVX2 are available. Unpaired surrogates are replaced by U+FFFD.
+ */
+class Utf8Transcoder {
+public:
+  Utf8Transcoder() = delete; // prevent instantiation of this class
+
+  static void Append(std::string& output, const GS::UniString& str);
+  static void AppendEscaped(std::string& output, const GS::UniString& str);
+
+private:
+  static void AppendUnits(std::string& output, const GS::UniString& str, bool isEscaped);
+};
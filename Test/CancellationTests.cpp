@@ -0,0 +1,208 @@
+#include "TestUtils.hpp"
+#include "CancellationToken.hpp"
+#include "DataExporter.hpp"
+#include "TimeSlicer.hpp"
+#include "Thirdparty/httplib.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::milliseconds;
+
+// Exports are cancelled this long after they start, and must stop within the bound after that. Work in slices sees
+// cancellation within a slice, and uploads within a PollInterval. The bound leaves ample room for the test being
+// descheduled on a busy machine, while still failing work that only stops once it is done.
+const Milliseconds CancelDelay{ 100 };
+const double MaxStopMilliseconds = 1000.0;
+
+// The stalled server answers after this long at the latest, so that an upload that cannot be cancelled fails the
+// test rather than hanging it
+const Milliseconds StallDuration{ 3000 };
+
+const Milliseconds SliceDuration{ 16 };
+const USize MaxStepSize = 8;
+
+/**
+ * @brief Cancels a token from another thread after a delay, as the dialog does while an export runs
+ */
+class DelayedCancel {
+public:
+  DelayedCancel(CancellationToken& cancellationToken, Milliseconds delay) :
+    m_thread([&cancellationToken, delay]()
+    {
+      std::this_thread::sleep_for(delay);
+      cancellationToken.Cancel();
+    })
+  {
+  }
+
+  ~DelayedCancel()
+  {
+    m_thread.join();
+  }
+
+private:
+  std::thread m_thread;
+};
+
+/**
+ * @brief A local server whose upload endpoint does not answer until released, standing in for a server that stalls
+ * part way through an export
+ */
+class StalledServer {
+public:
+  StalledServer() :
+    m_isReleased(false)
+  {
+    m_server.Post("/post", [this](const httplib::Request&, httplib::Response& response)
+    {
+      Clock::time_point start = Clock::now();
+      while (!m_isReleased && Clock::now() - start < StallDuration)
+        std::this_thread::sleep_for(Milliseconds(5));
+      response.status = httplib::StatusCode::OK_200;
+    });
+    m_port = m_server.bind_to_any_port("127.0.0.1");
+    m_thread = std::thread([this]()
+    {
+      m_server.listen_after_bind();
+    });
+  }
+
+  ~StalledServer()
+  {
+    m_isReleased = true;
+    m_server.stop();
+    m_thread.join();
+  }
+
+  std::string GetUrl() const
+  {
+    return "http://127.0.0.1:" + std::to_string(m_port) + "/";
+  }
+
+private:
+  httplib::Server m_server;
+  std::atomic<bool> m_isReleased;
+  int m_port;
+  std::thread m_thread;
+};
+
+/**
+ * @brief Spins for the given time, standing in for an element being fetched
+ */
+void SpinFor(std::chrono::microseconds duration)
+{
+  Clock::time_point start = Clock::now();
+  while (Clock::now() - start < duration)
+  {
+  }
+}
+
+void TestSlicedJob()
+{
+  // Run slices of endless work as an export job does, checking the token before each step
+  CancellationToken cancellationToken;
+  TimeSlicer slicer(SliceDuration, MaxStepSize);
+  {
+    DelayedCancel cancel(cancellationToken, CancelDelay);
+    bool isMoreWork = true;
+    while (isMoreWork)
+    {
+      isMoreWork = slicer.RunSlice([&cancellationToken](USize itemCount)
+      {
+        if (cancellationToken.IsCancelled())
+          return false;
+
+        for (USize i = 0; i < itemCount; ++i)
+          SpinFor(std::chrono::microseconds(500));
+        return true;
+      });
+    }
+    cancellationToken.MarkStopped();
+  }
+
+  TEST_CHECK(cancellationToken.IsCancelled());
+  TEST_CHECK(cancellationToken.GetStopMilliseconds() < MaxStopMilliseconds);
+}
+
+void TestStalledUpload()
+{
+  StalledServer server;
+  CancellationToken cancellationToken;
+  std::string errorStr;
+  bool isExported;
+  {
+    DelayedCancel cancel(cancellationToken, CancelDelay);
+    isExported = DataExporter::ExportToUrl("{}\n", server.GetUrl(), "application/json", cancellationToken, errorStr);
+    cancellationToken.MarkStopped();
+  }
+
+  TEST_CHECK(!isExported);
+  TEST_CHECK(errorStr == "Export was cancelled");
+  TEST_CHECK(cancellationToken.GetStopMilliseconds() < MaxStopMilliseconds);
+}
+
+void TestStalledFileUpload()
+{
+  std::string filePath = (std::filesystem::temp_directory_path() / "cancellation-tests-upload.json").string();
+  {
+    std::ofstream outFile(filePath, std::ofstream::binary);
+    outFile << "{}\n";
+  }
+
+  StalledServer server;
+  CancellationToken cancellationToken;
+  std::string errorStr;
+  bool isExported;
+  {
+    DelayedCancel cancel(cancellationToken, CancelDelay);
+    isExported = DataExporter::ExportFileToUrl(filePath, server.GetUrl(), "application/json", cancellationToken, errorStr);
+    cancellationToken.MarkStopped();
+  }
+
+  TEST_CHECK(!isExported);
+  TEST_CHECK(errorStr == "Export was cancelled");
+  TEST_CHECK(cancellationToken.GetStopMilliseconds() < MaxStopMilliseconds);
+
+  std::error_code errorCode;
+  std::filesystem::remove(filePath, errorCode);
+}
+
+void TestCancelledFileWrite()
+{
+  // A write that is cancelled before its first chunk writes nothing and leaves no file behind
+  std::string filePath = (std::filesystem::temp_directory_path() / "cancellation-tests-write.json").string();
+  CancellationToken cancellationToken;
+  cancellationToken.Cancel();
+  std::string errorStr;
+  TEST_CHECK(!DataExporter::ExportToFile(std::string(4 * 1024 * 1024, ' '), filePath, cancellationToken, errorStr));
+  TEST_CHECK(!std::filesystem::exists(filePath));
+  TEST_CHECK(!DataExporter::ExportChunkToFile("{}\n", filePath, false, cancellationToken, errorStr));
+  TEST_CHECK(!std::filesystem::exists(filePath));
+
+  // The time to stop is kept from when the export was marked as stopped, not from when it is read
+  cancellationToken.MarkStopped();
+  double stopMilliseconds = cancellationToken.GetStopMilliseconds();
+  std::this_thread::sleep_for(Milliseconds(20));
+  TEST_CHECK(cancellationToken.GetStopMilliseconds() == stopMilliseconds);
+}
+
+}
+
+/**
+ * @brief Checks that cancelled exports stop promptly, cancelling from another thread part way through work run in
+ * slices and uploads to a server that stalls
+ */
+int main()
+{
+  TestSlicedJob();
+  TestStalledUpload();
+  TestStalledFileUpload();
+  TestCancelledFileWrite();
+  return TestUtils::GetExitCode();
+}
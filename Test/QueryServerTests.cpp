@@ -0,0 +1,291 @@
+#include "TestUtils.hpp"
+#include "JsonWriter.hpp"
+#include "QueryServer.hpp"
+#include "Thirdparty/httplib.h"
+#include "Thirdparty/json.hpp"
+
+#include <algorithm>
+#include <map>
+
+using json = nlohmann::json;
+
+namespace {
+
+/**
+ * @brief A snapshot of made up elements, each with a type, a layer and whole number properties, written as the
+ * element snapshot writes them
+ */
+class SyntheticSnapshot : public QuerySnapshot {
+public:
+  struct Element
+  {
+    std::string guid;
+    std::string type;
+    std::string layer;
+    std::map<std::string, int> properties;
+  };
+
+  SyntheticSnapshot(std::vector<Element> elements, std::uint64_t tag) :
+    m_elements(std::move(elements)),
+    m_tag(tag)
+  {
+    for (const Element& element : m_elements)
+    {
+      for (const auto& property : element.properties)
+      {
+        if (std::find(m_propertyNames.begin(), m_propertyNames.end(), property.first) == m_propertyNames.end())
+          m_propertyNames.push_back(property.first);
+      }
+    }
+  }
+
+  std::uint64_t GetTag() const override
+  {
+    return m_tag;
+  }
+
+  std::int32_t GetRealDecimalPlaces() const override
+  {
+    return -1;
+  }
+
+  void FindElements(const Query& query, std::vector<std::uint32_t>& elemIndices) const override
+  {
+    for (std::uint32_t i = 0; i < m_elements.size(); ++i)
+    {
+      if (IsRequested(query.elemTypeNames, m_elements[i].type) && IsRequested(query.layerNames, m_elements[i].layer))
+        elemIndices.push_back(i);
+    }
+  }
+
+  void GetPropertyMask(const Query& query, std::vector<bool>& nameMask) const override
+  {
+    nameMask.clear();
+    for (const std::string& name : m_propertyNames)
+      nameMask.push_back(IsRequested(query.propertyNames, name));
+  }
+
+  void WriteElement(std::uint32_t elemIndex, const std::vector<bool>& nameMask, JsonWriter& writer) const override
+  {
+    const Element& element = m_elements[elemIndex];
+    writer.BeginObject();
+    writer.WriteKey("\"guid\"");
+    writer.WriteString(element.guid);
+    writer.WriteKey("\"type\"");
+    writer.WriteString(element.type);
+    writer.WriteKey("\"layer\"");
+    writer.WriteString(element.layer);
+    writer.WriteKey("\"properties\"");
+    writer.BeginObject();
+    for (const auto& property : element.properties)
+    {
+      size_t nameIndex = std::find(m_propertyNames.begin(), m_propertyNames.end(), property.first) - m_propertyNames.begin();
+      if (!nameMask[nameIndex])
+        continue;
+
+      std::string key;
+      JsonWriter::AppendQuoted(key, property.first);
+      writer.WriteKey(key);
+      writer.WriteInt(property.second);
+    }
+    writer.EndObject();
+    writer.EndObject();
+  }
+
+  void WriteTypes(JsonWriter& writer) const override
+  {
+    WriteNameCounts(&Element::type, writer);
+  }
+
+  void WriteLayers(JsonWriter& writer) const override
+  {
+    WriteNameCounts(&Element::layer, writer);
+  }
+
+private:
+  static bool IsRequested(const std::vector<std::string>& names, const std::string& name)
+  {
+    return names.empty() || std::find(names.begin(), names.end(), name) != names.end();
+  }
+
+  void WriteNameCounts(std::string Element::* name, JsonWriter& writer) const
+  {
+    std::map<std::string, int> counts;
+    for (const Element& element : m_elements)
+      ++counts[element.*name];
+
+    writer.BeginArray();
+    for (const auto& count : counts)
+    {
+      writer.BeginObject();
+      writer.WriteKey("\"name\"");
+      writer.WriteString(count.first);
+      writer.WriteKey("\"elements\"");
+      writer.WriteInt(count.second);
+      writer.EndObject();
+    }
+    writer.EndArray();
+  }
+
+  std::vector<Element> m_elements;
+  std::vector<std::string> m_propertyNames;
+  std::uint64_t m_tag;
+};
+
+std::shared_ptr<const QuerySnapshot> MakeSnapshot(size_t elementCount, std::uint64_t tag)
+{
+  const char* types[] = { "Wall", "Slab", "Column" };
+  const char* layers[] = { "Structure", "Finishes" };
+  std::vector<SyntheticSnapshot::Element> elements;
+  for (size_t i = 0; i < elementCount; ++i)
+  {
+    SyntheticSnapshot::Element element;
+    element.guid = "E" + std::to_string(1000 + i);
+    element.type = types[i % 3];
+    element.layer = layers[i % 2];
+    element.properties["Area"] = static_cast<int>(i);
+    element.properties["Height"] = static_cast<int>(i * 10);
+    elements.push_back(element);
+  }
+  return std::make_shared<const SyntheticSnapshot>(std::move(elements), tag);
+}
+
+void TestNoSnapshot(httplib::Client& client)
+{
+  httplib::Result result = client.Get("/types");
+  TEST_CHECK(result && result->status == 503);
+}
+
+void TestTypesAndLayers(httplib::Client& client)
+{
+  httplib::Result types = client.Get("/types");
+  TEST_CHECK(types && types->status == 200);
+  if (types)
+    TEST_CHECK(json::parse(types->body) == json::parse(R"({"types":[{"name":"Column","elements":8},{"name":"Slab","elements":8},{"name":"Wall","elements":9}]})"));
+
+  httplib::Result layers = client.Get("/layers");
+  TEST_CHECK(layers && layers->status == 200);
+  if (layers)
+    TEST_CHECK(json::parse(layers->body) == json::parse(R"({"layers":[{"name":"Finishes","elements":12},{"name":"Structure","elements":13}]})"));
+}
+
+void TestElementPaging(httplib::Client& client)
+{
+  // Following nextOffset visits every element once, in order
+  std::vector<std::string> guids;
+  size_t offset = 0;
+  for (int page = 0; page < 10; ++page)
+  {
+    httplib::Result result = client.Get("/elements?limit=7&offset=" + std::to_string(offset));
+    TEST_CHECK(result && result->status == 200);
+    if (!result)
+      return;
+
+    json body = json::parse(result->body);
+    TEST_CHECK(body["total"] == 25);
+    TEST_CHECK(body["offset"] == offset);
+    TEST_CHECK(body["limit"] == 7);
+    for (const json& element : body["elements"])
+      guids.push_back(element["guid"]);
+    if (!body.contains("nextOffset"))
+      break;
+    offset = body["nextOffset"];
+  }
+  TEST_CHECK(guids.size() == 25);
+  TEST_CHECK(guids.front() == "E1000" && guids.back() == "E1024");
+
+  // Offsets past the end give an empty page
+  httplib::Result pastEnd = client.Get("/elements?offset=100");
+  TEST_CHECK(pastEnd && pastEnd->status == 200);
+  if (pastEnd)
+    TEST_CHECK(json::parse(pastEnd->body)["elements"].empty());
+
+  // Types, layers and properties limit the elements and what is written of them
+  httplib::Result filtered = client.Get("/elements?type=Wall&layer=Structure&props=Height");
+  TEST_CHECK(filtered && filtered->status == 200);
+  if (filtered)
+  {
+    json body = json::parse(filtered->body);
+    TEST_CHECK(body["total"] == 5);
+    TEST_CHECK(body["elements"][1] == json::parse(R"({"guid":"E1006","type":"Wall","layer":"Structure","properties":{"Height":60}})"));
+  }
+}
+
+void TestBadPagingParams(httplib::Client& client)
+{
+  const char* paths[] = { "/elements?limit=0", "/elements?limit=-1", "/elements?offset=abc", "/elements?limit=5x" };
+  for (const char* path : paths)
+  {
+    httplib::Result result = client.Get(path);
+    TEST_CHECK(result && result->status == 400);
+  }
+}
+
+void TestNotModified(httplib::Client& client, QueryServer& server)
+{
+  httplib::Result first = client.Get("/elements?limit=3");
+  TEST_CHECK(first && first->status == 200 && first->has_header("ETag"));
+  if (!first)
+    return;
+
+  std::string etag = first->get_header_value("ETag");
+  httplib::Result repeated = client.Get("/elements?limit=3", { { "If-None-Match", etag } });
+  TEST_CHECK(repeated && repeated->status == 304 && repeated->body.empty());
+
+  // Other requests of the same snapshot, and the same request of a changed snapshot, have other tags
+  httplib::Result otherRequest = client.Get("/elements?limit=4", { { "If-None-Match", etag } });
+  TEST_CHECK(otherRequest && otherRequest->status == 200);
+
+  server.Publish(MakeSnapshot(25, 2));
+  httplib::Result changed = client.Get("/elements?limit=3", { { "If-None-Match", etag } });
+  TEST_CHECK(changed && changed->status == 200 && changed->get_header_value("ETag") != etag);
+}
+
+void TestHostNames(httplib::Client& client, std::uint32_t port)
+{
+  std::string portText = std::to_string(port);
+  const std::string localHosts[] = { "localhost", "LocalHost:" + portText, "127.0.0.1", "127.0.0.1:" + portText };
+  for (const std::string& host : localHosts)
+  {
+    httplib::Result result = client.Get("/types", { { "Host", host } });
+    TEST_CHECK(result && result->status == 200);
+  }
+
+  // Pages whose own host name resolves to the local machine must not be able to read from the server
+  const std::string otherHosts[] = { "attacker.example", "attacker.example:" + portText, "localhost.attacker.example", "127.0.0.1.nip.io", "localhost:", "" };
+  for (const std::string& host : otherHosts)
+  {
+    httplib::Result result = client.Get("/elements", { { "Host", host } });
+    TEST_CHECK(result && result->status == 403);
+  }
+}
+
+}
+
+/**
+ * @brief Runs the query server on a free local port against a synthetic snapshot, checking its responses as a
+ * client sees them
+ */
+int main()
+{
+  QueryServer server;
+  std::string errorStr;
+  if (!TEST_CHECK(server.Start(0, errorStr)))
+  {
+    std::fprintf(stderr, "%s\n", errorStr.c_str());
+    return TestUtils::GetExitCode();
+  }
+
+  httplib::Client client("127.0.0.1", static_cast<int>(server.GetPort()));
+  TestNoSnapshot(client);
+
+  server.Publish(MakeSnapshot(25, 1));
+  TestTypesAndLayers(client);
+  TestElementPaging(client);
+  TestBadPagingParams(client);
+  TestNotModified(client, server);
+  TestHostNames(client, server.GetPort());
+
+  server.Stop();
+  return TestUtils::GetExitCode();
+}
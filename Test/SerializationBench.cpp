@@ -0,0 +1,202 @@
+#include "ContentHash.hpp"
+#include "GuidFormatter.hpp"
+#include "JsonWriter.hpp"
+#include "Utf8Transcoder.hpp"
+#include "Thirdparty/json.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+const int Repeats = 200;
+
+/**
+ * @brief Runs a function repeatedly and returns the fastest time taken, in nanoseconds
+ */
+template <typename Function>
+double Measure(Function function)
+{
+  double fastest = 0.0;
+  for (int i = 0; i < 5; ++i)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    function();
+    double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (i == 0 || nanoseconds < fastest)
+      fastest = nanoseconds;
+  }
+  return fastest;
+}
+
+void Report(const char* name, double nanoseconds, double items, const char* unit, double baselineNanoseconds)
+{
+  std::printf("%-34s %8.2f ns/%s  (%.1fx baseline)\n", name, nanoseconds / items, unit, baselineNanoseconds / nanoseconds);
+}
+
+void BenchGuidFormatter()
+{
+  std::mt19937 random(1);
+  std::vector<API_Guid> guids(100000);
+  for (API_Guid& guid : guids)
+  {
+    guid.time_low = random();
+    guid.time_mid = static_cast<UInt16>(random());
+    guid.time_hi_and_version = static_cast<UInt16>(random());
+    guid.clock_seq_hi_and_reserved = static_cast<UInt8>(random());
+    guid.clock_seq_low = static_cast<UInt8>(random());
+    for (UInt8& node : guid.node)
+      node = static_cast<UInt8>(random());
+  }
+
+  // The baseline formats each guid into a new string, as APIGuidToString followed by ToCStr did
+  std::string output;
+  double baseline = Measure([&]()
+  {
+    output.clear();
+    for (const API_Guid& guid : guids)
+    {
+      char text[40];
+      std::snprintf(text, sizeof(text), "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+        guid.time_low, guid.time_mid, guid.time_hi_and_version, guid.clock_seq_hi_and_reserved, guid.clock_seq_low,
+        guid.node[0], guid.node[1], guid.node[2], guid.node[3], guid.node[4], guid.node[5]);
+      output += std::string(text);
+    }
+  });
+  double formatter = Measure([&]()
+  {
+    output.clear();
+    for (const API_Guid& guid : guids)
+      GuidFormatter::Append(output, guid);
+  });
+  Report("guid snprintf (baseline)", baseline, guids.size(), "guid", baseline);
+  Report("GuidFormatter::Append", formatter, guids.size(), "guid", baseline);
+}
+
+void BenchTranscoding(const char* name, const std::u16string& units)
+{
+  GS::UniString str(units);
+
+  // The baseline converts a code unit at a time into a temporary string, then escapes it
+  std::string output;
+  double baseline = Measure([&]()
+  {
+    for (int i = 0; i < Repeats; ++i)
+    {
+      std::string text;
+      for (char16_t unit : units)
+      {
+        if (unit < 0x80)
+        {
+          text += static_cast<char>(unit);
+        }
+        else if (unit < 0x800)
+        {
+          text += static_cast<char>(0xC0 | (unit >> 6));
+          text += static_cast<char>(0x80 | (unit & 0x3F));
+        }
+        else
+        {
+          text += static_cast<char>(0xE0 | (unit >> 12));
+          text += static_cast<char>(0x80 | ((unit >> 6) & 0x3F));
+          text += static_cast<char>(0x80 | (unit & 0x3F));
+        }
+      }
+      output.clear();
+      JsonWriter::AppendEscaped(output, text);
+    }
+  });
+  double transcoder = Measure([&]()
+  {
+    for (int i = 0; i < Repeats; ++i)
+    {
+      output.clear();
+      Utf8Transcoder::AppendEscaped(output, str);
+    }
+  });
+
+  std::printf("%s text:\n", name);
+  Report("  per-unit convert + escape", baseline, static_cast<double>(Repeats) * units.size(), "unit", baseline);
+  Report("  Utf8Transcoder::AppendEscaped", transcoder, static_cast<double>(Repeats) * units.size(), "unit", baseline);
+}
+
+void BenchEscaping()
+{
+  std::string text;
+  for (int i = 0; i < 100000; ++i)
+    text += "Wall - Exterior 300mm concrete, \"load bearing\"\n"[i % 48];
+
+  std::string output;
+  double baseline = Measure([&]()
+  {
+    for (int i = 0; i < Repeats; ++i)
+      output = json(text).dump();
+  });
+  double writer = Measure([&]()
+  {
+    for (int i = 0; i < Repeats; ++i)
+    {
+      output.clear();
+      JsonWriter::AppendQuoted(output, text);
+    }
+  });
+  Report("nlohmann string dump (baseline)", baseline, static_cast<double>(Repeats) * text.size(), "byte", baseline);
+  Report("JsonWriter::AppendQuoted", writer, static_cast<double>(Repeats) * text.size(), "byte", baseline);
+}
+
+void BenchContentHash()
+{
+  std::string text;
+  for (int i = 0; i < 1000000; ++i)
+    text += "{\"guid\":\"0F8E4A2C-9D1B-4E6F-A3C5-7B2D9E1F4A6C\",\"Area\":12.5}\n"[i % 59];
+
+  // The baseline is the FNV-1a hash used before, a byte at a time
+  UInt64 result = 0;
+  double baseline = Measure([&]()
+  {
+    UInt64 hash = 14695981039346656037ULL;
+    for (unsigned char byte : text)
+    {
+      hash ^= byte;
+      hash *= 1099511628211ULL;
+    }
+    result += hash;
+  });
+  double contentHash = Measure([&]()
+  {
+    result += ContentHash::Compute(text.data(), text.size());
+  });
+  Report("FNV-1a (baseline)", baseline, static_cast<double>(text.size()), "byte", baseline);
+  Report("ContentHash::Compute", contentHash, static_cast<double>(text.size()), "byte", baseline);
+  if (result == 0)
+    std::printf("\n");
+}
+
+}
+
+/**
+ * @brief Measures the serialization hot paths against the straightforward code they replaced. Each measurement is
+ * the fastest of several runs, and is given per item along with its speed-up over the baseline.
+ */
+int main()
+{
+  BenchGuidFormatter();
+
+  std::u16string ascii;
+  std::u16string cjk;
+  for (int i = 0; i < 4000; ++i)
+  {
+    ascii += u"Wall - Exterior 300mm concrete "[i % 31];
+    cjk += i % 5 != 0 ? static_cast<char16_t>(0x4E00 + i % 500) : u' ';
+  }
+  BenchTranscoding("ASCII", ascii);
+  BenchTranscoding("CJK", cjk);
+
+  BenchEscaping();
+  BenchContentHash();
+  return 0;
+}
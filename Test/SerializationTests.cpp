@@ -0,0 +1,355 @@
+#include "TestUtils.hpp"
+#include "ContentHash.hpp"
+#include "GuidFormatter.hpp"
+#include "JsonWriter.hpp"
+#include "Utf8Transcoder.hpp"
+#include "Thirdparty/json.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <set>
+
+using json = nlohmann::json;
+
+namespace {
+
+const int FuzzIterations = 20000;
+
+API_Guid RandomGuid(std::mt19937& random)
+{
+  API_Guid guid;
+  guid.time_low = random();
+  guid.time_mid = static_cast<UInt16>(random());
+  guid.time_hi_and_version = static_cast<UInt16>(random());
+  guid.clock_seq_hi_and_reserved = static_cast<UInt8>(random());
+  guid.clock_seq_low = static_cast<UInt8>(random());
+  for (UInt8& node : guid.node)
+    node = static_cast<UInt8>(random());
+  return guid;
+}
+
+/**
+ * @brief Formats a guid as APIGuidToString does
+ */
+std::string FormatGuid(const API_Guid& guid)
+{
+  char text[40];
+  std::snprintf(text, sizeof(text), "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+    guid.time_low, guid.time_mid, guid.time_hi_and_version, guid.clock_seq_hi_and_reserved, guid.clock_seq_low,
+    guid.node[0], guid.node[1], guid.node[2], guid.node[3], guid.node[4], guid.node[5]);
+  return text;
+}
+
+/**
+ * @brief Converts UTF-16 to UTF-8 a code point at a time, replacing unpaired surrogates by U+FFFD
+ */
+std::string EncodeUtf8(const std::u16string& units)
+{
+  std::string output;
+  for (size_t i = 0; i < units.size(); ++i)
+  {
+    UInt32 codePoint = units[i];
+    bool isHighSurrogate = codePoint >= 0xD800 && codePoint < 0xDC00;
+    if (isHighSurrogate && i + 1 < units.size() && units[i + 1] >= 0xDC00 && units[i + 1] < 0xE000)
+      codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (units[++i] - 0xDC00);
+    else if (codePoint >= 0xD800 && codePoint < 0xE000)
+      codePoint = 0xFFFD;
+
+    if (codePoint < 0x80)
+    {
+      output += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800)
+    {
+      output += static_cast<char>(0xC0 | (codePoint >> 6));
+      output += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000)
+    {
+      output += static_cast<char>(0xE0 | (codePoint >> 12));
+      output += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+      output += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+      output += static_cast<char>(0xF0 | (codePoint >> 18));
+      output += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+      output += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+      output += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+  }
+  return output;
+}
+
+/**
+ * @brief Builds a UTF-16 string mixing runs of ASCII, characters needing escapes, multi-byte characters and paired
+ * and unpaired surrogates. Lengths reach past the widest vector, so that both vector and scalar paths are taken.
+ */
+std::u16string RandomUnits(std::mt19937& random)
+{
+  std::u16string units;
+  size_t length = random() % 100;
+  bool isMostlyAscii = random() % 2 == 0;
+  while (units.size() < length)
+  {
+    UInt32 kind = random() % 10;
+    if (isMostlyAscii || kind < 6)
+      units += static_cast<char16_t>(0x20 + random() % 95);
+    else if (kind == 6)
+      units += static_cast<char16_t>(random() % 0x20);
+    else if (kind == 7)
+      units += u"\"\\\x7f"[random() % 3];
+    else if (kind == 8)
+      units += static_cast<char16_t>(random() % 2 == 0 ? 0x80 + random() % 0x780 : 0x800 + random() % 0xD000);
+    else if (random() % 2 == 0)
+      units += { static_cast<char16_t>(0xD800 + random() % 0x400), static_cast<char16_t>(0xDC00 + random() % 0x400) };
+    else
+      units += static_cast<char16_t>(0xD800 + random() % 0x800);
+  }
+  return units;
+}
+
+std::string RandomUtf8(std::mt19937& random, size_t maxLength)
+{
+  const char* multiByteCharacters[] = { "\xc3\xa9", "\xe4\xb8\xad", "\xf0\x9f\x98\x80", "\xc2\x80", "\xef\xbf\xbf" };
+  std::string text;
+  size_t length = random() % (maxLength + 1);
+  while (text.size() < length)
+  {
+    UInt32 kind = random() % 10;
+    if (kind < 6)
+      text += static_cast<char>(0x20 + random() % 95);
+    else if (kind == 6)
+      text += static_cast<char>(random() % 0x20);
+    else if (kind == 7)
+      text += "\"\\/\x7f"[random() % 4];
+    else
+      text += multiByteCharacters[random() % 5];
+  }
+  return text;
+}
+
+double RandomDouble(std::mt19937& random)
+{
+  switch (random() % 4)
+  {
+  case 0:
+    return static_cast<double>(static_cast<Int32>(random() % 100000));
+  case 1:
+    return std::ldexp(static_cast<double>(random()), static_cast<int>(random() % 400) - 200);
+  case 2:
+    return static_cast<Int32>(random() % 100000000) / std::pow(10.0, random() % 8) * (random() % 2 == 0 ? 1 : -1);
+  default:
+  {
+    // Any finite bit pattern
+    UInt64 bits = (static_cast<UInt64>(random()) << 32) | random();
+    double value;
+    std::memcpy(&value, &bits, sizeof(double));
+    return std::isfinite(value) ? value : 0.0;
+  }
+  }
+}
+
+/**
+ * @brief Writes a random document with the writer while building the same document as nlohmann json. Keys are
+ * written in sorted order without repeats, as nlohmann json objects order their keys.
+ */
+json WriteRandomValue(std::mt19937& random, int depth, bool& hasReals, JsonWriter& writer)
+{
+  UInt32 kind = depth < 4 ? random() % 7 : 2 + random() % 5;
+  switch (kind)
+  {
+  case 0:
+  {
+    std::set<std::string> keys;
+    for (UInt32 i = random() % 5; i > 0; --i)
+      keys.insert(RandomUtf8(random, 12));
+
+    json object = json::object();
+    writer.BeginObject();
+    for (const std::string& key : keys)
+    {
+      std::string escapedKey;
+      JsonWriter::AppendQuoted(escapedKey, key);
+      writer.WriteKey(escapedKey);
+      object[key] = WriteRandomValue(random, depth + 1, hasReals, writer);
+    }
+    writer.EndObject();
+    return object;
+  }
+  case 1:
+  {
+    json array = json::array();
+    writer.BeginArray();
+    for (UInt32 i = random() % 5; i > 0; --i)
+      array.push_back(WriteRandomValue(random, depth + 1, hasReals, writer));
+    writer.EndArray();
+    return array;
+  }
+  case 2:
+  {
+    std::string text = RandomUtf8(random, 40);
+    writer.WriteString(text);
+    return text;
+  }
+  case 3:
+  {
+    int value = static_cast<int>(random());
+    writer.WriteInt(value);
+    return value;
+  }
+  case 4:
+  {
+    double value = RandomDouble(random);
+    writer.WriteDouble(value);
+    hasReals = true;
+    return value;
+  }
+  default:
+  {
+    bool value = random() % 2 == 0;
+    writer.WriteBool(value);
+    return value;
+  }
+  }
+}
+
+void TestGuidFormatter()
+{
+  std::mt19937 random(1);
+  for (int i = 0; i < FuzzIterations; ++i)
+  {
+    API_Guid guid = RandomGuid(random);
+    std::string text = "prefix";
+    GuidFormatter::Append(text, guid);
+    TEST_CHECK(text == "prefix" + FormatGuid(guid));
+  }
+}
+
+void TestUtf8Transcoder()
+{
+  std::mt19937 random(2);
+  for (int i = 0; i < FuzzIterations * 5; ++i)
+  {
+    GS::UniString str(RandomUnits(random));
+    std::u16string units(str.ToUStr(), str.GetLength());
+    std::string expected = EncodeUtf8(units);
+
+    std::string text = "prefix";
+    Utf8Transcoder::Append(text, str);
+    TEST_CHECK(text == "prefix" + expected);
+
+    // Escaped output must match escaping the converted text, and nlohmann's own escaping once quoted
+    std::string escaped = "prefix";
+    Utf8Transcoder::AppendEscaped(escaped, str);
+    std::string expectedEscaped = "prefix";
+    JsonWriter::AppendEscaped(expectedEscaped, expected);
+    TEST_CHECK(escaped == expectedEscaped);
+    TEST_CHECK("\"" + escaped.substr(6) + "\"" == json(expected).dump());
+  }
+}
+
+void TestJsonEscaping()
+{
+  std::mt19937 random(3);
+  for (int i = 0; i < FuzzIterations * 5; ++i)
+  {
+    std::string text = RandomUtf8(random, 120);
+    std::string quoted;
+    JsonWriter::AppendQuoted(quoted, text);
+    TEST_CHECK(quoted == json(text).dump());
+  }
+}
+
+void TestJsonWriter()
+{
+  std::mt19937 random(4);
+  for (int indentWidth : { -1, 0, 2, 4 })
+  {
+    for (int i = 0; i < FuzzIterations; ++i)
+    {
+      JsonWriter writer(indentWidth);
+      bool hasReals = false;
+      json expected = WriteRandomValue(random, 0, hasReals, writer);
+
+      // Reals can be written with fewer digits than nlohmann's, so documents with reals are compared by value
+      TEST_CHECK(json::parse(writer.GetBuffer()) == expected);
+      if (!hasReals)
+        TEST_CHECK(writer.GetBuffer() == expected.dump(indentWidth));
+    }
+  }
+}
+
+void TestContentHash()
+{
+  // Reference xxHash64 values with a seed of zero, covering the short and the striped paths
+  std::string bytes;
+  for (int i = 0; i < 768; ++i)
+    bytes += static_cast<char>(i % 256);
+  TEST_CHECK(ContentHash::Compute("", 0) == 0xef46db3751d8e999ULL);
+  TEST_CHECK(ContentHash::Compute("a", 1) == 0xd24ec4f1a98c6e5bULL);
+  TEST_CHECK(ContentHash::Compute("abc", 3) == 0x44bc2cf5ad770999ULL);
+  TEST_CHECK(ContentHash::Compute("Nobody inspects the spammish repetition", 39) == 0xfbcea83c8a378bf1ULL);
+  TEST_CHECK(ContentHash::Compute(bytes.data(), bytes.size()) == 0x8e03c838c596036fULL);
+
+  // Hashing in pieces of any size must give the hash of the whole
+  std::mt19937 random(6);
+  for (int i = 0; i < FuzzIterations; ++i)
+  {
+    std::string text(random() % 300, '\0');
+    for (char& c : text)
+      c = static_cast<char>(random());
+
+    ContentHash hash;
+    for (size_t offset = 0; offset < text.size();)
+    {
+      size_t size = std::min<size_t>(random() % 70, text.size() - offset);
+      hash.Append(text.data() + offset, size);
+      offset += size;
+    }
+    TEST_CHECK(hash.GetValue() == ContentHash::Compute(text.data(), text.size()));
+  }
+}
+
+void TestRealValues()
+{
+  std::mt19937 random(5);
+  std::vector<double> values = { 0.0, -0.0, 1.0, 0.1, 1e-4, 1e-5, 1e15, 1e16, 1e21, 5e-324, 1.7976931348623157e308 };
+  for (int i = 0; i < FuzzIterations * 10; ++i)
+    values.push_back(RandomDouble(random));
+
+  // Real values are written with the fewest digits that read back as the same value, which is never more than
+  // nlohmann writes, laid out as nlohmann lays them out
+  for (double value : values)
+  {
+    JsonWriter writer(-1);
+    writer.WriteDouble(value);
+    std::string expected = json(value).dump();
+    TEST_CHECK(std::strtod(writer.GetBuffer().c_str(), nullptr) == value);
+    TEST_CHECK(writer.GetBuffer().size() <= expected.size());
+    TEST_CHECK((writer.GetBuffer().find('e') == std::string::npos) == (expected.find('e') == std::string::npos));
+  }
+
+  JsonWriter rounded(-1);
+  rounded.SetRealDecimalPlaces(3);
+  rounded.BeginArray();
+  for (double value : { 2.5, 1234.56789, 0.00012, 2.0005, 1.0 / 3 })
+    rounded.WriteDouble(value);
+  rounded.EndArray();
+  TEST_CHECK(rounded.GetBuffer() == "[2.5,1234.568,0.0,2.001,0.333]");
+}
+
+}
+
+int main()
+{
+  TestGuidFormatter();
+  TestUtf8Transcoder();
+  TestJsonEscaping();
+  TestJsonWriter();
+  TestContentHash();
+  TestRealValues();
+  return TestUtils::GetExitCode();
+}
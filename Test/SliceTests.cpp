@@ -0,0 +1,178 @@
+#include "TestUtils.hpp"
+#include "TimeSlicer.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Microseconds = std::chrono::microseconds;
+
+const Microseconds SliceDuration{ 16000 };
+const USize MaxStepSize = 8;
+
+/**
+ * @brief Stands in for the elements of an export, each taking a given time to fetch. Fetching advances a fake clock
+ * by each element's time rather than taking it, so that slices are timed exactly however busy the machine is.
+ */
+class StubElementSource {
+public:
+  Clock::time_point Now() const
+  {
+    return m_now;
+  }
+
+  void AddElements(size_t count, Microseconds minDuration, Microseconds maxDuration, std::mt19937& random)
+  {
+    std::uniform_int_distribution<Microseconds::rep> duration(minDuration.count(), maxDuration.count());
+    for (size_t i = 0; i < count; ++i)
+      m_durations.push_back(Microseconds(duration(random)));
+  }
+
+  bool Fetch(USize itemCount)
+  {
+    ++m_stepCount;
+    size_t end = std::min(m_fetchedCount + itemCount, m_durations.size());
+    for (; m_fetchedCount < end; ++m_fetchedCount)
+      m_now += m_durations[m_fetchedCount];
+    return m_fetchedCount < m_durations.size();
+  }
+
+  size_t GetElementCount() const
+  {
+    return m_durations.size();
+  }
+
+  size_t GetFetchedCount() const
+  {
+    return m_fetchedCount;
+  }
+
+  size_t GetStepCount() const
+  {
+    return m_stepCount;
+  }
+
+private:
+  Clock::time_point m_now;
+  std::vector<Microseconds> m_durations;
+  size_t m_fetchedCount = 0;
+  size_t m_stepCount = 0;
+};
+
+/**
+ * @brief Creates a slicer timed by the source's fake clock
+ */
+TimeSlicer CreateSlicer(Microseconds sliceDuration, const StubElementSource& source)
+{
+  return TimeSlicer(sliceDuration, MaxStepSize, [&source]()
+  {
+    return source.Now();
+  });
+}
+
+/**
+ * @brief Runs slices until the source is fetched, giving the duration of each slice
+ */
+std::vector<Microseconds> RunSlices(TimeSlicer& slicer, StubElementSource& source)
+{
+  std::vector<Microseconds> sliceDurations;
+  bool isMoreWork = true;
+  while (isMoreWork)
+  {
+    Clock::time_point start = source.Now();
+    isMoreWork = slicer.RunSlice([&source](USize itemCount)
+    {
+      return source.Fetch(itemCount);
+    });
+    sliceDurations.push_back(std::chrono::duration_cast<Microseconds>(source.Now() - start));
+  }
+  return sliceDurations;
+}
+
+void TestSteadyElements()
+{
+  std::mt19937 random(1);
+  StubElementSource source;
+  source.AddElements(3000, Microseconds(200), Microseconds(400), random);
+
+  TimeSlicer slicer = CreateSlicer(SliceDuration, source);
+  std::vector<Microseconds> sliceDurations = RunSlices(slicer, source);
+  TEST_CHECK(source.GetFetchedCount() == source.GetElementCount());
+
+  // Every slice stays within its duration, and all but the last are mostly used
+  Microseconds totalDuration{ 0 };
+  for (Microseconds duration : sliceDurations)
+  {
+    TEST_CHECK(duration <= SliceDuration + Microseconds(400));
+    totalDuration += duration;
+  }
+  TEST_CHECK(sliceDurations.size() > 1);
+  TEST_CHECK(totalDuration - sliceDurations.back() >= (SliceDuration / 2) * (sliceDurations.size() - 1));
+}
+
+void TestSlowingElements()
+{
+  std::mt19937 random(2);
+  StubElementSource source;
+  source.AddElements(1000, Microseconds(50), Microseconds(100), random);
+  source.AddElements(300, Microseconds(1000), Microseconds(2000), random);
+
+  // The slice in which elements become slower may overrun, but the slicer catches up with them by the next slice
+  TimeSlicer slicer = CreateSlicer(SliceDuration, source);
+  std::vector<Microseconds> sliceDurations = RunSlices(slicer, source);
+  TEST_CHECK(source.GetFetchedCount() == source.GetElementCount());
+
+  size_t overrunCount = 0;
+  for (Microseconds duration : sliceDurations)
+  {
+    if (duration > SliceDuration + Microseconds(2000))
+      ++overrunCount;
+  }
+  TEST_CHECK(overrunCount <= 1);
+}
+
+void TestElementsLongerThanSlice()
+{
+  std::mt19937 random(3);
+  StubElementSource source;
+  source.AddElements(10, Microseconds(3000), Microseconds(3000), random);
+
+  // Each slice still fetches one element, and no more
+  TimeSlicer slicer = CreateSlicer(Microseconds(2000), source);
+  std::vector<Microseconds> sliceDurations = RunSlices(slicer, source);
+  TEST_CHECK(source.GetFetchedCount() == source.GetElementCount());
+  TEST_CHECK(sliceDurations.size() == source.GetElementCount());
+  TEST_CHECK(source.GetStepCount() == source.GetElementCount());
+}
+
+void TestStoppedWork()
+{
+  // A step that reports no more work, as a cancelled export does, ends the slice at once
+  TimeSlicer slicer(SliceDuration, MaxStepSize);
+  size_t stepCount = 0;
+  bool isMoreWork = slicer.RunSlice([&stepCount](USize)
+  {
+    ++stepCount;
+    return false;
+  });
+  TEST_CHECK(!isMoreWork);
+  TEST_CHECK(stepCount == 1);
+}
+
+}
+
+/**
+ * @brief Checks that work run in time slices keeps each slice within its duration, against a stub element source
+ * whose elements take a known time to fetch on a fake clock
+ */
+int main()
+{
+  TestSteadyElements();
+  TestSlowingElements();
+  TestElementsLongerThanSlice();
+  TestStoppedWork();
+  return TestUtils::GetExitCode();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Stand-in for the few Archicad API types used by the modules built into the tests. These modules do not call the
+// API, so they can be built and tested without the API DevKit. The add-on itself is always built against the DevKit.
+
+#include <cstdint>
+#include <string>
+
+typedef int8_t Int8;
+typedef uint8_t UInt8;
+typedef int16_t Int16;
+typedef uint16_t UInt16;
+typedef int32_t Int32;
+typedef uint32_t UInt32;
+typedef int64_t Int64;
+typedef uint64_t UInt64;
+typedef uint32_t USize;
+
+namespace GS {
+
+struct UniChar
+{
+  typedef char16_t Layout;
+};
+
+/**
+ * @brief UTF-16 string holding its code units, as GS::UniString does
+ */
+class UniString {
+public:
+  UniString() = default;
+
+  explicit UniString(std::u16string units) :
+    m_units(std::move(units))
+  {
+  }
+
+  const UniChar::Layout* ToUStr() const
+  {
+    return m_units.c_str();
+  }
+
+  USize GetLength() const
+  {
+    return static_cast<USize>(m_units.size());
+  }
+
+private:
+  std::u16string m_units;
+};
+
+}
+
+struct API_Guid
+{
+  UInt32 time_low;
+  UInt16 time_mid;
+  UInt16 time_hi_and_version;
+  UInt8 clock_seq_hi_and_reserved;
+  UInt8 clock_seq_low;
+  UInt8 node[6];
+};
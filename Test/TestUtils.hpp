@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdio>
+
+/**
+ * @brief Minimal checks for the standalone tests. Failed checks are reported as they happen, and counted so that a
+ * test's exit code tells whether it passed. Fuzzed checks stop reporting after the first few failures.
+ */
+class TestUtils {
+public:
+  TestUtils() = delete; // prevent instantiation of this class
+
+  static bool Check(bool condition, const char* description, const char* file, int line)
+  {
+    if (condition)
+      return true;
+
+    if (++GetFailureCount() <= MaxReportedFailures)
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, description);
+    return false;
+  }
+
+  static int GetExitCode()
+  {
+    if (GetFailureCount() > 0)
+      std::fprintf(stderr, "%d checks failed\n", GetFailureCount());
+    return GetFailureCount() > 0 ? 1 : 0;
+  }
+
+private:
+  static const int MaxReportedFailures = 10;
+
+  static int& GetFailureCount()
+  {
+    static int failureCount = 0;
+    return failureCount;
+  }
+};
+
+#define TEST_CHECK(condition) TestUtils::Check((condition), #condition, __FILE__, __LINE__)